@@ -0,0 +1,1030 @@
+/*
+ art.h
+ Andrew J Wood
+
+ This header file defines fsu::ART<D>, an ordered associative array keyed by fsu::String and
+ implemented as an Adaptive Radix Tree (Leis, Kemper, Neumann 2013). It offers the same API as
+ fsu::OAA<fsu::String,D> so that clients such as WordSmith can switch containers with a typedef.
+
+ Keys are consumed one byte at a time. Inner nodes come in four sizes (Node4, Node16, Node48 and
+ Node256) and grow or shrink as children are added or removed. Chains of single-child nodes are
+ collapsed into a prefix stored in the node (path compression); up to MaxPrefix bytes are kept
+ inline and longer prefixes are recovered from the minimum leaf below the node. A lookup therefore
+ costs O(key length), independent of the number of keys.
+
+ Each key byte is mapped so that unsigned byte order agrees with String::StrCmp (which compares
+ plain char, signed on most platforms), and the terminating '\0' is treated as the last key byte.
+ No key is then a prefix of another, and an in-order walk of the tree visits keys in exactly the
+ order OAA<fsu::String,D> does, so Display() output is identical.
+
+ Erase() really removes the leaf, so Size() is kept as a counter and Rehash() has nothing to do.
+ */
+
+#ifndef _ART_H
+#define _ART_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t etc
+#include <climits>    // CHAR_MIN
+#include <cstring>    // strcmp, memcpy, memmove
+#include <iostream>
+#include <iomanip>
+#include <xstring.h>  // fsu::String
+#include <textbuffer.h> // TextBuffer, TextFormat, used by Display()
+
+namespace fsu
+{
+    template < typename D >
+    class ART
+    {
+    public:
+
+        typedef String    KeyType;
+        typedef D         DataType;
+
+        ART  ();
+        ART  (const ART& a);
+        ~ART ();
+        ART& operator=(const ART& a);
+
+        DataType& operator [] (const KeyType& k)        { return Get(k); }
+
+        void Put (const KeyType& k , const DataType& d) { Get(k) = d; }
+        D&   Get (const KeyType& k);
+
+        void Erase(const KeyType& k);
+        void Clear();
+        void Rehash() {} // Erase() reclaims leaves immediately; nothing to rebuild
+
+        // replaces the contents with n pairs from next(k, d), O(total key length). Same
+        // contract as OAA::Build (increasing key order), which is not checked here
+        template <class G>
+        bool Build (size_t n, G& next);
+
+        // present for OAA compatibility; radix descent does not benefit from a hot-key cache
+        void   SetCache  (size_t) {}
+        size_t CacheSize () const { return 0; }
+
+        bool   Empty    () const { return root_ == nullptr; }
+        size_t Size     () const { return size_; }             // counts keys
+        size_t NumNodes () const { return RNumNodes(root_); } // counts inner nodes and leaves
+        size_t EntryBytes () const { return sizeof(Leaf) + sizeof(Node*); } // a leaf and its child slot; inner nodes add more
+        int    Height   () const { return RHeight(root_); }
+
+        template <class F>
+        void   Traverse(F f) const { RTraverse(root_,f); }   // f applied to leaves in key order
+        template <class F>
+        void   ForEach (F f) const { Traverse(KeyData<F>(f)); } // f(key, data) in key order
+
+        void   Display (std::ostream& os, int kw, int dw,     // key, data widths
+                        std::ios_base::fmtflags kf = std::ios_base::right, // key flag
+                        std::ios_base::fmtflags df = std::ios_base::right // data flag
+        ) const;
+
+        void   Dump (std::ostream& os) const;                 // indented node structure
+
+    private: // definitions and relationships
+
+        enum NodeType { LEAF, NODE4, NODE16, NODE48, NODE256 };
+        enum { MaxPrefix = 10 };                                        // prefix bytes kept inline
+        static const unsigned char Bias = (CHAR_MIN < 0) ? 0x80 : 0x00; // maps signed char order
+
+        struct Node
+        {
+            uint8_t type_;
+            explicit Node (uint8_t t) : type_(t) {}
+        };
+
+        struct Leaf : public Node
+        {
+            const KeyType key_;
+            DataType      data_;
+            Leaf (const KeyType& k, const DataType& d) : Node(LEAF), key_(k), data_(d) {}
+        };
+
+        struct Inner : public Node
+        {
+            uint16_t      numChildren_;
+            uint32_t      prefixLen_;          // full length of the compressed path
+            unsigned char prefix_[MaxPrefix];  // first MaxPrefix bytes of it
+            explicit Inner (uint8_t t) : Node(t), numChildren_(0), prefixLen_(0) {}
+        };
+
+        struct Node4 : public Inner
+        {
+            unsigned char keys_[4];     // sorted
+            Node *        children_[4];
+            Node4 () : Inner(NODE4) {}
+        };
+
+        struct Node16 : public Inner
+        {
+            unsigned char keys_[16];    // sorted
+            Node *        children_[16];
+            Node16 () : Inner(NODE16) {}
+        };
+
+        struct Node48 : public Inner
+        {
+            unsigned char childIndex_[256]; // 0 = no child, else slot + 1
+            Node *        children_[48];
+            Node48 () : Inner(NODE48)
+            {
+                memset(childIndex_, 0, sizeof(childIndex_));
+                memset(children_, 0, sizeof(children_));
+            }
+        };
+
+        struct Node256 : public Inner
+        {
+            Node * children_[256];
+            Node256 () : Inner(NODE256) { memset(children_, 0, sizeof(children_)); }
+        };
+
+        template < class F >
+        class KeyData // f(key, data) as a Traverse() function object
+        {
+        public:
+            explicit KeyData (F& f) : f_(f) {}
+            void operator() (const Leaf * n) const { f_(n->key_, n->data_); }
+        private:
+            F& f_;
+        };
+
+        class PrintLeaf
+        {
+        public:
+            PrintLeaf (std::ostream& os, int kw, int dw,
+                       std::ios_base::fmtflags kf, std::ios_base::fmtflags df )
+            : os_(os), kw_(kw), dw_(dw), kf_(kf), df_(df) {}
+            void operator() (const Leaf * l) const
+            {
+                os_.setf(kf_,std::ios_base::adjustfield);
+                os_ << std::setw(kw_) << l->key_;
+                os_.setf(df_,std::ios_base::adjustfield);
+                os_ << std::setw(dw_) << l->data_;
+                os_ << '\n';
+            }
+        private:
+            std::ostream& os_;
+            int kw_, dw_;      // key and data column widths
+            std::ios_base::fmtflags kf_, df_; // column adjustment flags for output stream
+        };
+
+        // PrintLeaf through a TextBuffer, for data types with a TextFormat
+        class WriteLeaf
+        {
+        public:
+            WriteLeaf (TextBuffer& tb, int kw, int dw,
+                       std::ios_base::fmtflags kf, std::ios_base::fmtflags df, char fill )
+            : tb_(tb), kw_(kw), dw_(dw), kf_(kf), df_(df), fill_(fill) {}
+            void operator() (const Leaf * l) const
+            {
+                char kscratch[TextFormat<KeyType>::Size], dscratch[TextFormat<D>::Size];
+                size_t kn, dn;
+                const char* kt = TextFormat<KeyType>::Text(l->key_, kscratch, kn);
+                const char* dt = TextFormat<D>::Text(l->data_, dscratch, dn);
+                if (kt != nullptr) //else << prints nothing, not even padding
+                    tb_.Field(kt, kn, kw_, kf_, fill_, 0);
+                if (dt != nullptr)
+                    tb_.Field(dt, dn, dw_, df_, fill_, TextFormat<D>::numeric);
+                tb_.Put('\n');
+            }
+        private:
+            TextBuffer& tb_;
+            int kw_, dw_;
+            std::ios_base::fmtflags kf_, df_;
+            char fill_;
+        };
+
+    private: // data
+        Node *  root_;
+        size_t  size_;
+
+    private: // methods
+
+        // key bytes: the C-string of the key including its terminator, biased by Bias
+        static const char * Bytes (const KeyType& k) { return k.Cstr() ? k.Cstr() : ""; }
+        static unsigned char Byte (const char* key, size_t depth)
+        {
+            return (unsigned char)key[depth] ^ Bias;
+        }
+        static bool IsLeaf (const Node * n) { return n->type_ == LEAF; }
+        static size_t Stored (size_t len) { return len < (size_t)MaxPrefix ? len : (size_t)MaxPrefix; } // inline part of a prefix
+
+        static Leaf * NewLeaf      (const KeyType& k, const DataType& d);
+        template < class N >
+        static N *    NewInner     ();
+        static void   CopyHeader   (Inner * to, const Inner * from);
+        static void   DeleteNode   (Node * n);
+
+        static Node ** FindChild   (Inner * n, unsigned char c);
+        static void    AddChild    (Node ** ref, Inner * n, unsigned char c, Node * child);
+        static void    RemoveChild (Node ** ref, Inner * n, unsigned char c, Node ** slot);
+        static Leaf *  Minimum     (const Node * n);
+        static size_t  PrefixMismatch (const Inner * n, const char* key, size_t depth);
+
+        static void   RRelease  (Node * n); // deletes n and all descendants
+        static Node * RClone    (const Node * n);
+        static size_t RNumNodes (const Node * n);
+        static int    RHeight   (const Node * n);
+        static void   RDump     (std::ostream& os, const Node * n, int level);
+
+        template < class F >
+        static void   RTraverse (const Node * n, F f);
+
+    }; // class ART<>
+
+
+    // API
+
+    template < typename D >
+    D& ART<D>::Get (const KeyType& k)
+    // returns reference to data value associated with k; inserts if necessary
+    {
+        const char* key = Bytes(k);
+        Node ** ref = &root_;
+        size_t depth = 0;
+        while (1)
+        {
+            Node * n = *ref;
+            if (n == nullptr) // empty slot: new leaf
+            {
+                Leaf * l = NewLeaf(k, D());
+                *ref = l;
+                ++size_;
+                return l->data_;
+            }
+            if (IsLeaf(n))
+            {
+                Leaf * old = static_cast<Leaf*>(n);
+                const char* oldkey = Bytes(old->key_);
+                if (strcmp(oldkey, key) == 0)
+                    return old->data_;
+
+                // two keys share this slot: replace the leaf with a Node4 over their common bytes
+                size_t lcp = 0;
+                while (Byte(oldkey, depth + lcp) == Byte(key, depth + lcp))
+                    ++lcp;
+                Node4 * nn = NewInner<Node4>();
+                nn->prefixLen_ = (uint32_t)lcp;
+                for (size_t i = 0; i < lcp && i < MaxPrefix; ++i)
+                    nn->prefix_[i] = Byte(key, depth + i);
+                Leaf * l = NewLeaf(k, D());
+                *ref = nn;
+                AddChild(ref, nn, Byte(oldkey, depth + lcp), old);
+                AddChild(ref, nn, Byte(key, depth + lcp), l);
+                ++size_;
+                return l->data_;
+            }
+
+            Inner * in = static_cast<Inner*>(n);
+            if (in->prefixLen_ > 0)
+            {
+                size_t diff = PrefixMismatch(in, key, depth);
+                if (diff < in->prefixLen_) // key leaves the compressed path: split it
+                {
+                    Node4 * nn = NewInner<Node4>();
+                    nn->prefixLen_ = (uint32_t)diff;
+                    memcpy(nn->prefix_, in->prefix_, Stored(diff));
+                    *ref = nn;
+                    if (in->prefixLen_ <= MaxPrefix)
+                    {
+                        AddChild(ref, nn, in->prefix_[diff], in);
+                        in->prefixLen_ -= (uint32_t)(diff + 1);
+                        memmove(in->prefix_, in->prefix_ + diff + 1,
+                                Stored(in->prefixLen_));
+                    }
+                    else // the stored prefix is truncated; recover bytes from a leaf
+                    {
+                        in->prefixLen_ -= (uint32_t)(diff + 1);
+                        const char* minkey = Bytes(Minimum(in)->key_);
+                        AddChild(ref, nn, Byte(minkey, depth + diff), in);
+                        for (size_t i = 0; i < in->prefixLen_ && i < MaxPrefix; ++i)
+                            in->prefix_[i] = Byte(minkey, depth + diff + 1 + i);
+                    }
+                    Leaf * l = NewLeaf(k, D());
+                    AddChild(ref, nn, Byte(key, depth + diff), l);
+                    ++size_;
+                    return l->data_;
+                }
+                depth += in->prefixLen_;
+            }
+
+            unsigned char c = Byte(key, depth);
+            Node ** child = FindChild(in, c);
+            if (child == nullptr)
+            {
+                Leaf * l = NewLeaf(k, D());
+                AddChild(ref, in, c, l);
+                ++size_;
+                return l->data_;
+            }
+            ref = child;
+            ++depth;
+        }
+    }
+
+    template < typename D >
+    void ART<D>::Erase (const KeyType& k)
+    {
+        const char* key = Bytes(k);
+        if (root_ == nullptr)
+            return;
+        if (IsLeaf(root_))
+        {
+            if (strcmp(Bytes(static_cast<Leaf*>(root_)->key_), key) == 0)
+            {
+                DeleteNode(root_);
+                root_ = nullptr;
+                --size_;
+            }
+            return;
+        }
+        Node ** ref = &root_;
+        size_t depth = 0;
+        while (1)
+        {
+            Inner * in = static_cast<Inner*>(*ref);
+            if (PrefixMismatch(in, key, depth) < in->prefixLen_)
+                return; // not present
+            depth += in->prefixLen_;
+            unsigned char c = Byte(key, depth);
+            Node ** child = FindChild(in, c);
+            if (child == nullptr)
+                return;
+            if (IsLeaf(*child))
+            {
+                Node * l = *child;
+                if (strcmp(Bytes(static_cast<Leaf*>(l)->key_), key) != 0)
+                    return;
+                RemoveChild(ref, in, c, child);
+                DeleteNode(l);
+                --size_;
+                return;
+            }
+            ref = child;
+            ++depth;
+        }
+    }
+
+    template < typename D >
+    void ART<D>::Clear ()
+    {
+        RRelease(root_);
+        root_ = nullptr;
+        size_ = 0;
+    }
+
+    template < typename D >
+    void ART<D>::Display (std::ostream& os, int kw, int dw, std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
+    {
+        if (TextFormat<D>::enabled && PlainDecimal(os))
+        {   //same bytes as PrintLeaf, formatted into a buffer and written in large chunks
+            {
+                TextBuffer tb(os);
+                WriteLeaf wl(tb, kw, dw, kf, df, os.fill());
+                Traverse(wl);
+            }
+            if (size_ > 0) //leave the stream as PrintLeaf would
+            {
+                os.setf(df,std::ios_base::adjustfield);
+                os.width(0);
+            }
+            return;
+        }
+        PrintLeaf pl(os, kw, dw, kf, df);
+        Traverse(pl);
+    }
+
+    template < typename D >
+    void ART<D>::Dump (std::ostream& os) const
+    {
+        RDump(os, root_, 0);
+    }
+
+    // proper type
+
+    template < typename D >
+    ART<D>::ART () : root_(nullptr), size_(0)
+    {}
+
+    template < typename D >
+    ART<D>::ART (const ART& a) : root_(nullptr), size_(a.size_)
+    {
+        root_ = RClone(a.root_);
+    }
+
+    template < typename D >
+    ART<D>::~ART ()
+    {
+        Clear();
+    }
+
+    template < typename D >
+    ART<D>& ART<D>::operator= (const ART& a)
+    {
+        if (this != &a)
+        {
+            Clear();
+            root_ = RClone(a.root_);
+            size_ = a.size_;
+        }
+        return *this;
+    }
+
+    // node management
+
+    template < typename D >
+    typename ART<D>::Leaf * ART<D>::NewLeaf (const KeyType& k, const DataType& d)
+    {
+        Leaf * l = new(std::nothrow) Leaf(k,d);
+        if (l == nullptr)
+        {
+            std::cerr << "** ART memory allocation failure\n";
+        }
+        return l;
+    }
+
+    template < typename D >
+    template < class N >
+    N * ART<D>::NewInner ()
+    {
+        N * n = new(std::nothrow) N;
+        if (n == nullptr)
+        {
+            std::cerr << "** ART memory allocation failure\n";
+        }
+        return n;
+    }
+
+    template < typename D >
+    void ART<D>::CopyHeader (Inner * to, const Inner * from)
+    {
+        to->numChildren_ = from->numChildren_;
+        to->prefixLen_   = from->prefixLen_;
+        memcpy(to->prefix_, from->prefix_, MaxPrefix);
+    }
+
+    template < typename D >
+    void ART<D>::DeleteNode (Node * n)
+    // deletes n only, by its dynamic type
+    {
+        switch (n->type_)
+        {
+            case LEAF:    delete static_cast<Leaf*>(n);    break;
+            case NODE4:   delete static_cast<Node4*>(n);   break;
+            case NODE16:  delete static_cast<Node16*>(n);  break;
+            case NODE48:  delete static_cast<Node48*>(n);  break;
+            case NODE256: delete static_cast<Node256*>(n); break;
+        }
+    }
+
+    template < typename D >
+    typename ART<D>::Node ** ART<D>::FindChild (Inner * n, unsigned char c)
+    {
+        switch (n->type_)
+        {
+            case NODE4:
+            {
+                Node4 * p = static_cast<Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i)
+                    if (p->keys_[i] == c) return &p->children_[i];
+                return nullptr;
+            }
+            case NODE16:
+            {
+                Node16 * p = static_cast<Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_ && p->keys_[i] <= c; ++i)
+                    if (p->keys_[i] == c) return &p->children_[i];
+                return nullptr;
+            }
+            case NODE48:
+            {
+                Node48 * p = static_cast<Node48*>(n);
+                unsigned char slot = p->childIndex_[c];
+                return slot ? &p->children_[slot - 1] : nullptr;
+            }
+            case NODE256:
+            {
+                Node256 * p = static_cast<Node256*>(n);
+                return p->children_[c] ? &p->children_[c] : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    template < typename D >
+    void ART<D>::AddChild (Node ** ref, Inner * n, unsigned char c, Node * child)
+    // adds child under byte c; *ref is replaced when n has to grow
+    {
+        switch (n->type_)
+        {
+            case NODE4:
+            {
+                Node4 * p = static_cast<Node4*>(n);
+                if (p->numChildren_ < 4)
+                {
+                    size_t i = 0;
+                    while (i < p->numChildren_ && p->keys_[i] < c) ++i;
+                    memmove(p->keys_ + i + 1, p->keys_ + i, p->numChildren_ - i);
+                    memmove(p->children_ + i + 1, p->children_ + i, (p->numChildren_ - i) * sizeof(Node*));
+                    p->keys_[i] = c;
+                    p->children_[i] = child;
+                    ++p->numChildren_;
+                    return;
+                }
+                Node16 * nn = NewInner<Node16>();
+                CopyHeader(nn, p);
+                memcpy(nn->keys_, p->keys_, 4);
+                memcpy(nn->children_, p->children_, 4 * sizeof(Node*));
+                *ref = nn;
+                delete p;
+                AddChild(ref, nn, c, child);
+                return;
+            }
+            case NODE16:
+            {
+                Node16 * p = static_cast<Node16*>(n);
+                if (p->numChildren_ < 16)
+                {
+                    size_t i = 0;
+                    while (i < p->numChildren_ && p->keys_[i] < c) ++i;
+                    memmove(p->keys_ + i + 1, p->keys_ + i, p->numChildren_ - i);
+                    memmove(p->children_ + i + 1, p->children_ + i, (p->numChildren_ - i) * sizeof(Node*));
+                    p->keys_[i] = c;
+                    p->children_[i] = child;
+                    ++p->numChildren_;
+                    return;
+                }
+                Node48 * nn = NewInner<Node48>();
+                CopyHeader(nn, p);
+                for (size_t i = 0; i < 16; ++i)
+                {
+                    nn->children_[i] = p->children_[i];
+                    nn->childIndex_[p->keys_[i]] = (unsigned char)(i + 1);
+                }
+                *ref = nn;
+                delete p;
+                AddChild(ref, nn, c, child);
+                return;
+            }
+            case NODE48:
+            {
+                Node48 * p = static_cast<Node48*>(n);
+                if (p->numChildren_ < 48)
+                {
+                    size_t pos = 0;
+                    while (p->children_[pos] != nullptr) ++pos; // erased slots leave holes
+                    p->children_[pos] = child;
+                    p->childIndex_[c] = (unsigned char)(pos + 1);
+                    ++p->numChildren_;
+                    return;
+                }
+                Node256 * nn = NewInner<Node256>();
+                CopyHeader(nn, p);
+                for (size_t i = 0; i < 256; ++i)
+                    if (p->childIndex_[i])
+                        nn->children_[i] = p->children_[p->childIndex_[i] - 1];
+                *ref = nn;
+                delete p;
+                AddChild(ref, nn, c, child);
+                return;
+            }
+            case NODE256:
+            {
+                Node256 * p = static_cast<Node256*>(n);
+                p->children_[c] = child;
+                ++p->numChildren_;
+                return;
+            }
+        }
+    }
+
+    template < typename D >
+    void ART<D>::RemoveChild (Node ** ref, Inner * n, unsigned char c, Node ** slot)
+    // removes the child at slot (under byte c); *ref is replaced when n shrinks
+    {
+        switch (n->type_)
+        {
+            case NODE4:
+            {
+                Node4 * p = static_cast<Node4*>(n);
+                size_t i = slot - p->children_;
+                memmove(p->keys_ + i, p->keys_ + i + 1, p->numChildren_ - 1 - i);
+                memmove(p->children_ + i, p->children_ + i + 1, (p->numChildren_ - 1 - i) * sizeof(Node*));
+                --p->numChildren_;
+                if (p->numChildren_ == 1) // collapse: the survivor absorbs our prefix and its byte
+                {
+                    Node * child = p->children_[0];
+                    if (!IsLeaf(child))
+                    {
+                        Inner * ch = static_cast<Inner*>(child);
+                        size_t len = p->prefixLen_;
+                        if (len < MaxPrefix)
+                            p->prefix_[len++] = p->keys_[0];
+                        if (len < MaxPrefix)
+                        {
+                            size_t sub = ch->prefixLen_ < MaxPrefix - len ? ch->prefixLen_ : MaxPrefix - len;
+                            memcpy(p->prefix_ + len, ch->prefix_, sub);
+                            len += sub;
+                        }
+                        memcpy(ch->prefix_, p->prefix_, Stored(len));
+                        ch->prefixLen_ += p->prefixLen_ + 1;
+                    }
+                    *ref = child;
+                    delete p;
+                }
+                return;
+            }
+            case NODE16:
+            {
+                Node16 * p = static_cast<Node16*>(n);
+                size_t i = slot - p->children_;
+                memmove(p->keys_ + i, p->keys_ + i + 1, p->numChildren_ - 1 - i);
+                memmove(p->children_ + i, p->children_ + i + 1, (p->numChildren_ - 1 - i) * sizeof(Node*));
+                --p->numChildren_;
+                if (p->numChildren_ == 3)
+                {
+                    Node4 * nn = NewInner<Node4>();
+                    CopyHeader(nn, p);
+                    memcpy(nn->keys_, p->keys_, 3);
+                    memcpy(nn->children_, p->children_, 3 * sizeof(Node*));
+                    *ref = nn;
+                    delete p;
+                }
+                return;
+            }
+            case NODE48:
+            {
+                Node48 * p = static_cast<Node48*>(n);
+                p->children_[p->childIndex_[c] - 1] = nullptr;
+                p->childIndex_[c] = 0;
+                --p->numChildren_;
+                if (p->numChildren_ == 12)
+                {
+                    Node16 * nn = NewInner<Node16>();
+                    CopyHeader(nn, p);
+                    size_t j = 0;
+                    for (size_t i = 0; i < 256; ++i)
+                    {
+                        if (p->childIndex_[i])
+                        {
+                            nn->keys_[j] = (unsigned char)i;
+                            nn->children_[j] = p->children_[p->childIndex_[i] - 1];
+                            ++j;
+                        }
+                    }
+                    *ref = nn;
+                    delete p;
+                }
+                return;
+            }
+            case NODE256:
+            {
+                Node256 * p = static_cast<Node256*>(n);
+                p->children_[c] = nullptr;
+                --p->numChildren_;
+                if (p->numChildren_ == 37)
+                {
+                    Node48 * nn = NewInner<Node48>();
+                    CopyHeader(nn, p);
+                    size_t pos = 0;
+                    for (size_t i = 0; i < 256; ++i)
+                    {
+                        if (p->children_[i])
+                        {
+                            nn->children_[pos] = p->children_[i];
+                            nn->childIndex_[i] = (unsigned char)(pos + 1);
+                            ++pos;
+                        }
+                    }
+                    *ref = nn;
+                    delete p;
+                }
+                return;
+            }
+        }
+    }
+
+    template < typename D >
+    typename ART<D>::Leaf * ART<D>::Minimum (const Node * n)
+    // leftmost leaf below n
+    {
+        while (n != nullptr && !IsLeaf(n))
+        {
+            switch (n->type_)
+            {
+                case NODE4:  n = static_cast<const Node4*>(n)->children_[0];  break;
+                case NODE16: n = static_cast<const Node16*>(n)->children_[0]; break;
+                case NODE48:
+                {
+                    const Node48 * p = static_cast<const Node48*>(n);
+                    size_t i = 0;
+                    while (!p->childIndex_[i]) ++i;
+                    n = p->children_[p->childIndex_[i] - 1];
+                    break;
+                }
+                case NODE256:
+                {
+                    const Node256 * p = static_cast<const Node256*>(n);
+                    size_t i = 0;
+                    while (!p->children_[i]) ++i;
+                    n = p->children_[i];
+                    break;
+                }
+            }
+        }
+        return const_cast<Leaf*>(static_cast<const Leaf*>(n));
+    }
+
+    template < typename D >
+    size_t ART<D>::PrefixMismatch (const Inner * n, const char* key, size_t depth)
+    // number of leading bytes of n's compressed path that match key at depth.
+    // Prefix bytes never equal the mapped terminator, so the scan stops at or
+    // before the end of key.
+    {
+        size_t i = 0;
+        size_t stored = Stored(n->prefixLen_);
+        for (; i < stored; ++i)
+            if (n->prefix_[i] != Byte(key, depth + i))
+                return i;
+        if (n->prefixLen_ > MaxPrefix)
+        {
+            const char* minkey = Bytes(Minimum(n)->key_);
+            for (; i < n->prefixLen_; ++i)
+                if (Byte(minkey, depth + i) != Byte(key, depth + i))
+                    return i;
+        }
+        return i;
+    }
+
+    // private static recursive methods
+
+    template < typename D >
+    void ART<D>::RRelease (Node * n)
+    {
+        if (n == nullptr) return;
+        switch (n->type_)
+        {
+            case NODE4:
+            {
+                Node4 * p = static_cast<Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RRelease(p->children_[i]);
+                break;
+            }
+            case NODE16:
+            {
+                Node16 * p = static_cast<Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RRelease(p->children_[i]);
+                break;
+            }
+            case NODE48:
+            {
+                Node48 * p = static_cast<Node48*>(n);
+                for (size_t i = 0; i < 48; ++i) RRelease(p->children_[i]);
+                break;
+            }
+            case NODE256:
+            {
+                Node256 * p = static_cast<Node256*>(n);
+                for (size_t i = 0; i < 256; ++i) RRelease(p->children_[i]);
+                break;
+            }
+        }
+        DeleteNode(n);
+    }
+
+    template < typename D >
+    typename ART<D>::Node * ART<D>::RClone (const Node * n)
+    // returns a pointer to a deep copy of n
+    {
+        if (n == nullptr) return nullptr;
+        switch (n->type_)
+        {
+            case LEAF:
+            {
+                const Leaf * l = static_cast<const Leaf*>(n);
+                return NewLeaf(l->key_, l->data_);
+            }
+            case NODE4:
+            {
+                const Node4 * p = static_cast<const Node4*>(n);
+                Node4 * q = NewInner<Node4>();
+                CopyHeader(q, p);
+                memcpy(q->keys_, p->keys_, sizeof(q->keys_));
+                for (size_t i = 0; i < p->numChildren_; ++i) q->children_[i] = RClone(p->children_[i]);
+                return q;
+            }
+            case NODE16:
+            {
+                const Node16 * p = static_cast<const Node16*>(n);
+                Node16 * q = NewInner<Node16>();
+                CopyHeader(q, p);
+                memcpy(q->keys_, p->keys_, sizeof(q->keys_));
+                for (size_t i = 0; i < p->numChildren_; ++i) q->children_[i] = RClone(p->children_[i]);
+                return q;
+            }
+            case NODE48:
+            {
+                const Node48 * p = static_cast<const Node48*>(n);
+                Node48 * q = NewInner<Node48>();
+                CopyHeader(q, p);
+                memcpy(q->childIndex_, p->childIndex_, sizeof(q->childIndex_));
+                for (size_t i = 0; i < 48; ++i) q->children_[i] = RClone(p->children_[i]);
+                return q;
+            }
+            case NODE256:
+            {
+                const Node256 * p = static_cast<const Node256*>(n);
+                Node256 * q = NewInner<Node256>();
+                CopyHeader(q, p);
+                for (size_t i = 0; i < 256; ++i) q->children_[i] = RClone(p->children_[i]);
+                return q;
+            }
+        }
+        return nullptr;
+    }
+
+    template < typename D >
+    template < class G >
+    bool ART<D>::Build (size_t n, G& next)
+    {
+        Clear();
+        KeyType k;
+        D d;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!next(k, d))
+            {
+                Clear();
+                return 0;
+            }
+            Get(k) = d;
+        }
+        return 1;
+    }
+
+    template < typename D >
+    template < class F >
+    void ART<D>::RTraverse (const Node * n, F f)
+    // in-order: children in increasing byte order
+    {
+        if (n == nullptr) return;
+        switch (n->type_)
+        {
+            case LEAF:
+                f(static_cast<const Leaf*>(n));
+                break;
+            case NODE4:
+            {
+                const Node4 * p = static_cast<const Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RTraverse(p->children_[i], f);
+                break;
+            }
+            case NODE16:
+            {
+                const Node16 * p = static_cast<const Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RTraverse(p->children_[i], f);
+                break;
+            }
+            case NODE48:
+            {
+                const Node48 * p = static_cast<const Node48*>(n);
+                for (size_t i = 0; i < 256; ++i)
+                    if (p->childIndex_[i]) RTraverse(p->children_[p->childIndex_[i] - 1], f);
+                break;
+            }
+            case NODE256:
+            {
+                const Node256 * p = static_cast<const Node256*>(n);
+                for (size_t i = 0; i < 256; ++i) RTraverse(p->children_[i], f);
+                break;
+            }
+        }
+    }
+
+    template < typename D >
+    size_t ART<D>::RNumNodes (const Node * n)
+    {
+        size_t count = 0;
+        if (n == nullptr) return 0;
+        switch (n->type_)
+        {
+            case LEAF: return 1;
+            case NODE4:
+            {
+                const Node4 * p = static_cast<const Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) count += RNumNodes(p->children_[i]);
+                break;
+            }
+            case NODE16:
+            {
+                const Node16 * p = static_cast<const Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) count += RNumNodes(p->children_[i]);
+                break;
+            }
+            case NODE48:
+            {
+                const Node48 * p = static_cast<const Node48*>(n);
+                for (size_t i = 0; i < 48; ++i) count += RNumNodes(p->children_[i]);
+                break;
+            }
+            case NODE256:
+            {
+                const Node256 * p = static_cast<const Node256*>(n);
+                for (size_t i = 0; i < 256; ++i) count += RNumNodes(p->children_[i]);
+                break;
+            }
+        }
+        return 1 + count;
+    }
+
+    template < typename D >
+    int ART<D>::RHeight (const Node * n)
+    {
+        if (n == nullptr) return -1;
+        int h = -1, ch;
+        switch (n->type_)
+        {
+            case LEAF: return 0;
+            case NODE4:
+            {
+                const Node4 * p = static_cast<const Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i)
+                    if ((ch = RHeight(p->children_[i])) > h) h = ch;
+                break;
+            }
+            case NODE16:
+            {
+                const Node16 * p = static_cast<const Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i)
+                    if ((ch = RHeight(p->children_[i])) > h) h = ch;
+                break;
+            }
+            case NODE48:
+            {
+                const Node48 * p = static_cast<const Node48*>(n);
+                for (size_t i = 0; i < 48; ++i)
+                    if ((ch = RHeight(p->children_[i])) > h) h = ch;
+                break;
+            }
+            case NODE256:
+            {
+                const Node256 * p = static_cast<const Node256*>(n);
+                for (size_t i = 0; i < 256; ++i)
+                    if ((ch = RHeight(p->children_[i])) > h) h = ch;
+                break;
+            }
+        }
+        return 1 + h;
+    }
+
+    template < typename D >
+    void ART<D>::RDump (std::ostream& os, const Node * n, int level)
+    {
+        if (n == nullptr) return;
+        os << std::setw(2 * level + 1) << ' ';
+        if (IsLeaf(n))
+        {
+            const Leaf * l = static_cast<const Leaf*>(n);
+            os << '"' << l->key_ << "\" : " << l->data_ << '\n';
+            return;
+        }
+        const Inner * in = static_cast<const Inner*>(n);
+        static const char* names[] = { "Leaf", "Node4", "Node16", "Node48", "Node256" };
+        os << names[in->type_] << " children = " << in->numChildren_
+           << " prefix = " << in->prefixLen_ << '\n';
+        switch (n->type_)
+        {
+            case NODE4:
+            {
+                const Node4 * p = static_cast<const Node4*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RDump(os, p->children_[i], level + 1);
+                break;
+            }
+            case NODE16:
+            {
+                const Node16 * p = static_cast<const Node16*>(n);
+                for (size_t i = 0; i < p->numChildren_; ++i) RDump(os, p->children_[i], level + 1);
+                break;
+            }
+            case NODE48:
+            {
+                const Node48 * p = static_cast<const Node48*>(n);
+                for (size_t i = 0; i < 256; ++i)
+                    if (p->childIndex_[i]) RDump(os, p->children_[p->childIndex_[i] - 1], level + 1);
+                break;
+            }
+            case NODE256:
+            {
+                const Node256 * p = static_cast<const Node256*>(n);
+                for (size_t i = 0; i < 256; ++i) RDump(os, p->children_[i], level + 1);
+                break;
+            }
+        }
+    }
+
+} // namespace fsu
+
+#endif
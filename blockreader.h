@@ -0,0 +1,206 @@
+/*
+    blockreader.h
+    Andrew J Wood
+
+    Read-ahead block input from a file descriptor.
+
+    BlockReader reads a descriptor such as standard input or a pipe in large
+    blocks, double buffered: while the caller works on one block, a second
+    thread reads the next into the other buffer, so reading and processing
+    overlap. Each block is filled completely unless input ends, and Next()
+    hands blocks back in input order; a block stays valid until the next call
+    to Next() or Close(). Blocks are raw bytes and may end anywhere, including
+    inside a word.
+
+    If the reader thread cannot be started, Next() reads each block itself.
+    The descriptor is not closed by BlockReader. Link with -pthread.
+*/
+
+#ifndef _BLOCKREADER_H
+#define _BLOCKREADER_H
+
+#include <cstddef>      // size_t
+#include <cerrno>       // errno, EINTR
+#include <iostream>     // std::cerr
+#include <new>          // std::nothrow
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <system_error>
+#include <unistd.h>     // read
+
+namespace fsu
+{
+
+  class BlockReader
+  {
+  public:
+    BlockReader  ();
+    ~BlockReader () { Close(); }
+
+    bool Open  (int fd, size_t blockSize = 4 << 20); // false if the buffers cannot be had
+    void Close ();                                   // stops reading; joins the reader
+    bool Next  (const char*& block, size_t& n);      // false at end of input
+
+    bool Error () const;                             // a read() failed; input ended early
+
+  private:
+    int       fd_;
+    char *    buf_[2];
+    size_t    len_[2];
+    bool      full_[2];     // buf_[i] holds a block the caller has not taken
+    size_t    size_;        // block size
+    size_t    next_;        // buffer of the next block to hand out
+    bool      held_;        // the caller has buf_[1 - next_]
+    bool      eof_, error_, stop_;
+    std::thread             reader_;
+    mutable std::mutex      lock_;  // guards len_, full_, held_, eof_, error_, stop_
+    std::condition_variable changed_;
+
+    size_t Fill (char* buf, bool& eof, bool& error) const; // reads up to size_ bytes
+    void   Run  ();                                         // reader thread body
+
+    BlockReader (const BlockReader&);            // not copyable
+    BlockReader& operator = (const BlockReader&);
+  } ;
+
+  inline BlockReader::BlockReader ()
+    : fd_(-1), size_(0), next_(0), held_(0), eof_(0), error_(0), stop_(0)
+  {
+    buf_[0] = buf_[1] = nullptr;
+    len_[0] = len_[1] = 0;
+    full_[0] = full_[1] = 0;
+  }
+
+  inline bool BlockReader::Open (int fd, size_t blockSize)
+  {
+    Close();
+    if (blockSize < 4096) blockSize = 4096;
+    buf_[0] = new(std::nothrow) char [blockSize];
+    buf_[1] = new(std::nothrow) char [blockSize];
+    if (buf_[0] == nullptr || buf_[1] == nullptr)
+    {
+      std::cerr << "** BlockReader memory allocation failure\n";
+      Close();
+      return 0;
+    }
+    fd_ = fd;
+    size_ = blockSize;
+    try
+    {
+      reader_ = std::thread(&BlockReader::Run, this);
+    }
+    catch (const std::system_error&) //Next() reads for itself
+    {}
+    return 1;
+  }
+
+  inline void BlockReader::Close ()
+  {
+    if (reader_.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> g(lock_);
+        stop_ = 1;
+      }
+      changed_.notify_all();
+      reader_.join(); //finishes at most the read in progress
+    }
+    delete [] buf_[0];
+    delete [] buf_[1];
+    buf_[0] = buf_[1] = nullptr;
+    len_[0] = len_[1] = 0;
+    full_[0] = full_[1] = 0;
+    fd_ = -1;
+    size_ = next_ = 0;
+    held_ = eof_ = error_ = stop_ = 0;
+  }
+
+  inline size_t BlockReader::Fill (char* buf, bool& eof, bool& error) const
+  {
+    size_t n = 0;
+    while (n < size_)
+    {
+      ssize_t got = read(fd_, buf + n, size_ - n);
+      if (got < 0 && errno == EINTR)
+        continue;
+      if (got <= 0)
+      {
+        error = (got < 0);
+        eof = 1;
+        break;
+      }
+      n += (size_t)got;
+    }
+    return n;
+  }
+
+  inline void BlockReader::Run ()
+  {
+    for (size_t i = 0; ; i = 1 - i)
+    {
+      {
+        std::unique_lock<std::mutex> g(lock_);
+        while (full_[i] && !stop_)
+          changed_.wait(g);
+        if (stop_)
+          return;
+      }
+      // the buffer is free: the caller has neither taken nor been handed it
+      bool eof = 0, error = 0;
+      size_t n = Fill(buf_[i], eof, error);
+      {
+        std::lock_guard<std::mutex> g(lock_);
+        len_[i] = n;
+        full_[i] = 1;
+        eof_ = eof;
+        error_ = error_ || error;
+      }
+      changed_.notify_all();
+      if (eof)
+        return;
+    }
+  }
+
+  inline bool BlockReader::Next (const char*& block, size_t& n)
+  {
+    if (buf_[0] == nullptr)
+      return 0;
+    if (!reader_.joinable()) //no reader thread: one buffer, read here
+    {
+      if (eof_)
+        return 0;
+      len_[0] = Fill(buf_[0], eof_, error_);
+      block = buf_[0];
+      n = len_[0];
+      return n > 0;
+    }
+    std::unique_lock<std::mutex> g(lock_);
+    if (held_) //the caller is done with the previous block: the reader may refill it
+    {
+      full_[1 - next_] = 0;
+      held_ = 0;
+      changed_.notify_all();
+    }
+    while (!full_[next_])
+    {
+      if (eof_) //the last block has been handed out
+        return 0;
+      changed_.wait(g);
+    }
+    block = buf_[next_];
+    n = len_[next_];
+    held_ = 1;
+    next_ = 1 - next_;
+    return n > 0;
+  }
+
+  inline bool BlockReader::Error () const
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    return error_;
+  }
+
+} // namespace fsu
+
+#endif
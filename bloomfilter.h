@@ -0,0 +1,112 @@
+/*
+    bloomfilter.h
+    Andrew J Wood
+
+    A fixed-size Bloom filter over precomputed hash values.
+
+    The client hashes its keys (see hashfunctions.h) and passes the hash to
+    Insert() and MayContain(). The filter derives its probe positions from that
+    one value by double hashing, so keys are hashed once per operation.
+    MayContain() never returns false for an inserted value; it returns true for
+    a value that was never inserted with probability about 0.6185^bitsPerKey
+    while Count() <= Capacity().
+
+    Reset() sizes the filter for an expected number of entries and clears it.
+    There is no removal: clients that erase keys keep the filter conservative
+    and rebuild it from scratch when convenient.
+*/
+
+#ifndef _BLOOMFILTER_H
+#define _BLOOMFILTER_H
+
+#include <cstddef>   // size_t
+#include <iostream>  // std::cerr
+#include <new>       // std::nothrow
+
+namespace fsu
+{
+
+  class BloomFilter
+  {
+  public:
+    BloomFilter  () : bits_(nullptr), mask_(0), numHashes_(0), count_(0), capacity_(0) {}
+    ~BloomFilter () { delete [] bits_; }
+
+    bool   Reset       (size_t capacity, size_t bitsPerKey); // size and clear; 0 bitsPerKey releases
+    void   Release     () { Reset(0,0); }
+
+    void   Insert      (size_t h);
+    bool   MayContain  (size_t h) const;
+
+    bool   Active      () const { return bits_ != nullptr; }
+    size_t Count       () const { return count_; }    // Insert() calls since Reset()
+    size_t Capacity    () const { return capacity_; } // entries the filter was sized for
+    size_t NumBits     () const { return bits_ ? mask_ + 1 : 0; }
+
+  private:
+    typedef unsigned long long Word;
+
+    Word *  bits_;
+    size_t  mask_;      // number of bits - 1 (a power of 2 - 1)
+    size_t  numHashes_;
+    size_t  count_;
+    size_t  capacity_;
+
+    static Word Mix (Word x) // splitmix64 finalizer; spreads weak hashes such as std::hash<int>
+    {
+      x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+    }
+
+    BloomFilter (const BloomFilter&);            // not copyable
+    BloomFilter& operator = (const BloomFilter&);
+  } ;
+
+  inline bool BloomFilter::Reset (size_t capacity, size_t bitsPerKey)
+  {
+    delete [] bits_;
+    bits_ = nullptr;
+    mask_ = numHashes_ = count_ = capacity_ = 0;
+    if (bitsPerKey == 0)
+      return 1;
+
+    size_t want = capacity * bitsPerKey, n = 512;
+    while (n < want) n <<= 1;
+    bits_ = new(std::nothrow) Word [n / 64];
+    if (bits_ == nullptr)
+    {
+      std::cerr << "** BloomFilter memory allocation failure\n";
+      return 0;
+    }
+    for (size_t i = 0; i < n / 64; ++i)
+      bits_[i] = 0;
+    mask_ = n - 1;
+    capacity_ = capacity;
+    numHashes_ = (bitsPerKey * 69 + 50) / 100; // bitsPerKey * ln 2, rounded
+    if (numHashes_ < 1) numHashes_ = 1;
+    if (numHashes_ > 16) numHashes_ = 16;
+    return 1;
+  }
+
+  inline void BloomFilter::Insert (size_t h)
+  {
+    Word x = Mix(h), step = (x >> 32) | 1;
+    for (size_t i = 0; i < numHashes_; ++i, x += step)
+      bits_[(x & mask_) >> 6] |= (Word)1 << (x & 63);
+    ++count_;
+  }
+
+  inline bool BloomFilter::MayContain (size_t h) const
+  {
+    Word x = Mix(h), step = (x >> 32) | 1;
+    for (size_t i = 0; i < numHashes_; ++i, x += step)
+      if (0 == (bits_[(x & mask_) >> 6] & ((Word)1 << (x & 63))))
+        return 0;
+    return 1;
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,296 @@
+/*
+    boaa.cpp
+    Andrew J Wood
+
+    Benchmark driver for OAA<String, size_t>, ART<size_t> and HashTable<String, size_t>
+
+    Reads the words of a text file into memory, then replays them <copies>
+    times as a WordSmith-style ingest (++table[word]) against each table
+    variant, reporting wall time and throughput. The default of 1000 copies
+    scales english.txt up to about 1.5M words. The hash table is timed once
+    more with its first Display(), which sorts the keys.
+
+    A second benchmark applies sorted batches of count deltas to a table of
+    about 100K distinct keys, once key by key with Get() and once with
+    OAA::BatchUpdate(), which resumes each search from the previous one.
+
+    A third benchmark is insert-heavy: rantable-style random <String, length>
+    entries (almost every key new) are loaded into an OAA with each insertion
+    policy, bottom-up (2-3) and top-down (2-3-4), then looked up once.
+
+    A fourth benchmark is insert/erase churn: a sliding window of random keys,
+    each key erased a fixed number of steps after its insert, run once with
+    tombstone erase and once with LLRB deletion (OAA::SetEraseMode()).
+
+    usage: boaa <textfile> [copies]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm> // std::sort, std::unique
+#include <oaa.h>
+#include <art.h>
+#include <hashtable.h>
+#include <xstring.h>
+#include <xran.h>
+#include <xranxstr.h>
+#include <xstring.cpp>  // in lieu of makefile
+#include <xran.cpp>     // in lieu of makefile
+#include <xranxstr.cpp> // in lieu of makefile
+
+typedef fsu::String KeyType;
+typedef size_t      DataType;
+
+// same order as fsu::LessThan<String>, but with no KeyPrefix specialization,
+// so the OAA descent compares full keys at every level
+class PlainLess
+{
+public:
+  bool operator () (const KeyType& k1, const KeyType& k2) const
+  {
+    return k1 < k2;
+  }
+} ;
+
+class Timer
+{
+public:
+  Timer () : start_(std::chrono::steady_clock::now()) {}
+  double Seconds () const
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+private:
+  std::chrono::steady_clock::time_point start_;
+} ;
+
+void Report (const char* label, double secs, size_t words, size_t vocab)
+{
+  std::cout << "  " << std::left << std::setw(28) << label << std::right
+            << std::fixed << std::setprecision(3) << std::setw(9) << secs << " s"
+            << std::setw(10) << std::setprecision(2) << (words / secs) / 1.0e6 << " Mwords/s"
+            << std::setw(10) << vocab << " keys\n";
+}
+
+template < class C >
+void Ingest (const char* label, C& table, const KeyType* words, size_t numwords, size_t copies)
+{
+  Timer t;
+  for (size_t c = 0; c < copies; ++c)
+    for (size_t i = 0; i < numwords; ++i)
+      ++table[words[i]];
+  Report(label, t.Seconds(), numwords * copies, table.Size());
+}
+
+class AddDelta
+{
+public:
+  void operator () (DataType& d, DataType delta) const { d += delta; }
+} ;
+
+void SortedBatches (const KeyType* words, size_t numwords)
+{
+  // distinct keys: the vocabulary crossed with a two-letter suffix
+  KeyType * keys = new KeyType [numwords];
+  for (size_t i = 0; i < numwords; ++i)
+    keys[i] = words[i];
+  std::sort(keys, keys + numwords);
+  size_t vocab = std::unique(keys, keys + numwords) - keys;
+  size_t numkeys = vocab * 26 * 6;
+  KeyType * all = new KeyType [numkeys];
+  char suffix[3] = { 0, 0, 0 };
+  size_t n = 0;
+  for (size_t i = 0; i < vocab; ++i)
+    for (char a = 'a'; a <= 'z'; ++a)
+      for (char b = 'a'; b <= 'f'; ++b)
+      {
+        suffix[0] = a; suffix[1] = b;
+        all[n++] = keys[i] + KeyType(suffix);
+      }
+  std::sort(all, all + numkeys);
+
+  const size_t stride = 8, rounds = 50;
+  size_t m = numkeys / stride;
+  KeyType  * batch  = new KeyType [m];
+  DataType * deltas = new DataType [m];
+  for (size_t i = 0; i < m; ++i)
+  {
+    batch[i] = all[i * stride + (i % stride)];
+    deltas[i] = 1 + i % 3;
+  }
+
+  std::cout << "Sorted batch benchmark: " << rounds << " batches of " << m
+            << " sorted keys into " << numkeys << " keys\n\n";
+  {
+    fsu::OAA<KeyType,DataType> table;
+    for (size_t i = 0; i < numkeys; ++i) table[all[i]];
+    Timer t;
+    for (size_t r = 0; r < rounds; ++r)
+      for (size_t i = 0; i < m; ++i)
+        table[batch[i]] += deltas[i];
+    Report("OAA, Get per key", t.Seconds(), m * rounds, table.Size());
+  }
+  {
+    fsu::OAA<KeyType,DataType> table;
+    for (size_t i = 0; i < numkeys; ++i) table[all[i]];
+    Timer t;
+    for (size_t r = 0; r < rounds; ++r)
+      table.BatchUpdate(batch, batch + m, deltas, AddDelta());
+    Report("OAA, BatchUpdate (finger)", t.Seconds(), m * rounds, table.Size());
+  }
+  std::cout << '\n';
+
+  delete [] keys;
+  delete [] all;
+  delete [] batch;
+  delete [] deltas;
+}
+
+template < class C >
+void LoadRandata (const char* label, const KeyType* keys, const DataType* lens, size_t num)
+{
+  C table;
+  Timer t;
+  for (size_t i = 0; i < num; ++i)
+    table[keys[i]] = lens[i];
+  Report(label, t.Seconds(), num, table.Size());
+  DataType sum = 0;
+  Timer u;
+  for (size_t i = 0; i < num; ++i)
+    sum += table[keys[i]];
+  Report("  then one Get per key", u.Seconds(), num, table.Size());
+  if (sum == 0) std::cout << '\n'; // keeps the lookups from being optimized away
+}
+
+void InsertHeavy (size_t num)
+{
+  // same distribution as rantable: keys of length [3,8], data = key length
+  KeyType  * keys = new KeyType [num];
+  DataType * lens = new DataType [num];
+  fsu::Random_String ranString;
+  fsu::Random_int ranint;
+  for (size_t i = 0; i < num; ++i)
+  {
+    lens[i] = ranint(3, 9);
+    keys[i] = ranString(lens[i]);
+  }
+
+  std::cout << "Insert-heavy benchmark: " << num << " random entries (randata)\n\n";
+  LoadRandata < fsu::OAA<KeyType,DataType> >
+    ("OAA, bottom-up insert", keys, lens, num);
+  LoadRandata < fsu::OAA<KeyType,DataType,fsu::LessThan<KeyType>,fsu::TopDownInsert> >
+    ("OAA, top-down insert", keys, lens, num);
+  std::cout << '\n';
+
+  delete [] keys;
+  delete [] lens;
+}
+
+void Churn (size_t num, size_t window)
+{
+  KeyType * keys = new KeyType [num];
+  fsu::Random_String ranString;
+  fsu::Random_int ranint;
+  for (size_t i = 0; i < num; ++i)
+    keys[i] = ranString(ranint(3, 9));
+
+  typedef fsu::OAA<KeyType,DataType> TableType;
+  std::cout << "Churn benchmark: " << num << " inserts, each erased " << window << " steps later\n\n";
+  const char* labels[2] = { "OAA, tombstone erase", "OAA, LLRB delete" };
+  TableType::EraseMode modes[2] = { TableType::TOMBSTONE, TableType::REMOVE };
+  for (size_t m = 0; m < 2; ++m)
+  {
+    TableType table;
+    table.SetEraseMode(modes[m]);
+    Timer t;
+    for (size_t i = 0; i < num; ++i)
+    {
+      table[keys[i]] = i;
+      if (i >= window)
+        table.Erase(keys[i - window]);
+    }
+    Report(labels[m], t.Seconds(), 2 * num, table.Size());
+    std::cout << "    nodes " << table.NumNodes() << ", height " << table.Height() << '\n';
+  }
+  std::cout << '\n';
+
+  delete [] keys;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cout << " ** Arguments: textfile [copies]\n"
+              << "    Try again\n";
+    return 0;
+  }
+  size_t copies = (argc > 2) ? atoi(argv[2]) : 1000;
+
+  std::ifstream ifs(argv[1]);
+  if (ifs.fail())
+  {
+    std::cout << " ** Cannot open file " << argv[1] << '\n';
+    return 0;
+  }
+  size_t numwords = 0, capacity = 1024;
+  KeyType * words = new KeyType [capacity];
+  KeyType word;
+  while (ifs >> word)
+  {
+    if (numwords == capacity)
+    {
+      KeyType * bigger = new KeyType [2 * capacity];
+      for (size_t i = 0; i < numwords; ++i)
+        bigger[i] = words[i];
+      delete [] words;
+      words = bigger;
+      capacity *= 2;
+    }
+    words[numwords++] = word;
+  }
+  ifs.close();
+
+  std::cout << "\nIngest benchmark: " << argv[1] << " (" << numwords << " words) x "
+            << copies << " = " << numwords * copies << " words\n\n";
+
+  {
+    fsu::OAA<KeyType,DataType,PlainLess> table;
+    Ingest("OAA, full key compares", table, words, numwords, copies);
+  }
+  {
+    fsu::OAA<KeyType,DataType> table;
+    Ingest("OAA, inline key prefix", table, words, numwords, copies);
+  }
+  {
+    fsu::OAA<KeyType,DataType> table;
+    table.SetCache(1024);
+    Ingest("OAA, prefix + hot-key cache", table, words, numwords, copies);
+  }
+  {
+    fsu::ART<DataType> table;
+    Ingest("ART", table, words, numwords, copies);
+  }
+  {
+    fsu::HashTable<KeyType,DataType> table;
+    Ingest("HashTable", table, words, numwords, copies);
+    std::ostringstream report;
+    Timer t;
+    table.Display(report, 0, 1);
+    std::cout << "    first Display (sort) " << std::fixed << std::setprecision(3)
+              << 1000 * t.Seconds() << " ms\n";
+  }
+
+  std::cout << '\n';
+
+  SortedBatches(words, numwords);
+  InsertHeavy(1000000);
+  Churn(1000000, 10000);
+
+  delete [] words;
+  return 0;
+}
@@ -0,0 +1,218 @@
+/*
+    ccleanup.cpp
+    Andrew J Wood
+
+    Differential test driver for WordSmith::Cleanup
+
+    Compares the table-driven Cleanup of cleanup.cpp, in both its String and
+    its character-range form, with the original Element/isalpha version kept
+    here as a reference, on
+
+      - every token of a text file (english.txt by default),
+      - random byte strings of up to 24 bytes, any byte value, NUL and
+        high-bit bytes included (a String ends at its first NUL for both),
+      - every string of up to 6 characters over the rule alphabet: letters
+        of both cases, digits, the joiners \ ' - . and , : and one junk
+        character.
+
+    Each mismatch is reported (the first few in full) and the driver exits
+    non-zero if there is any.
+
+    usage: ccleanup [textfile] [random strings]
+*/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cctype>
+#include <random>
+#include <xstring.h>
+#include <xstring.cpp>  // in lieu of makefile
+
+// the two Cleanup overloads as WordSmith declares them, so cleanup.cpp compiles on its own
+class WordSmith
+{
+public:
+  static void   Cleanup (fsu::String& s);
+  static size_t Cleanup (const char* s, size_t length, char* out);
+} ;
+
+#include <cleanup.cpp>  // in lieu of makefile
+
+// the baseline Cleanup, as it was before the table-driven rewrite; ctype arguments are cast
+// to unsigned char, which gives the same answers for high-bit bytes in the "C" locale
+void ReferenceCleanup (fsu::String& s)
+{
+  size_t length = s.Length();
+  char * newCharString = new char [length + 1];
+  size_t charArrayIndex = 0;
+  size_t n = 0;
+
+  #define E(i) ((unsigned char)s.Element(i))
+  while (
+         !(E(n) == '\0' ||
+           isalpha(E(n)) ||
+           isdigit(E(n)) ||
+           E(n) == '\\' ||
+           (E(n) == '-' && isdigit(E(n+1))) ||
+           (E(n) == ':' && E(n+1) == ':' && isalnum(E(n+2)))
+          ) && (n < length)
+        )
+  {
+    ++n;
+  }
+
+  while (
+         (
+          isalnum(E(n)) ||
+          (E(n) == '\\' && isalnum(E(n+1))) ||
+          (E(n) == '\'' && isalnum(E(n+1))) ||
+          (E(n) == '-' && isalnum(E(n+1)))  ||
+          (E(n) == '.' && isalnum(E(n+1)))  ||
+          (E(n) == ',' && isdigit(E(n-1)) && isdigit(E(n+1))) ||
+          (E(n) == ':' && isdigit(E(n-1)) && isdigit(E(n+1))) ||
+          (E(n) == ':' && E(n+1) == ':' && isalnum(E(n-1)) && isalnum(E(n+2))) ||
+          (E(n) == ':' && E(n-1) == ':' && isalnum(E(n-2)) && isalnum(E(n+1))) ||
+          (E(n) == ':' && E(n+1) == ':' && isalnum(E(n+2))) ||
+          (E(n) == ':' && E(n-1) == ':' && isalnum(E(n+1)))
+         ) && (n < length)
+        )
+  {
+    newCharString[charArrayIndex] = (char)tolower(E(n));
+    ++charArrayIndex;
+    ++n;
+  }
+  #undef E
+
+  newCharString[charArrayIndex] = '\0';
+  s.Wrap(newCharString);
+  delete [] newCharString;
+}
+
+// writes s with unprintable bytes as \xHH
+void Show (std::ostream& os, const char* s, size_t n)
+{
+  os << '"';
+  for (size_t i = 0; i < n; ++i)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c >= 32 && c < 127)
+      os << (char)c;
+    else
+      os << "\\x" << std::hex << std::setw(2) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+  }
+  os << '"';
+}
+
+class Checker
+{
+public:
+  Checker () : tests_(0), mismatches_(0) {}
+
+  void Check (const char* s, size_t n) // the input as n bytes
+  {
+    fsu::String input(n, ' ');
+    for (size_t i = 0; i < n; ++i)
+      input[i] = s[i];
+
+    fsu::String expected = input, actual = input;
+    ReferenceCleanup(expected);
+    WordSmith::Cleanup(actual);
+    char * out = new char [n + 1];
+    size_t k = WordSmith::Cleanup(s, n, out);
+
+    ++tests_;
+    bool same = Same(expected, actual.Cstr(), actual.Size()) && Same(expected, out, k);
+    if (!same && ++mismatches_ <= 20)
+    {
+      std::cout << "  ** mismatch on ";
+      Show(std::cout, s, n);
+      std::cout << ": reference ";
+      Show(std::cout, expected.Cstr(), expected.Size());
+      std::cout << ", String ";
+      Show(std::cout, actual.Cstr(), actual.Size());
+      std::cout << ", range ";
+      Show(std::cout, out, k);
+      std::cout << '\n';
+    }
+    delete [] out;
+  }
+
+  size_t Tests      () const { return tests_; }
+  size_t Mismatches () const { return mismatches_; }
+
+private:
+  size_t tests_, mismatches_;
+
+  static bool Same (const fsu::String& a, const char* b, size_t n)
+  {
+    if (a.Size() != n)
+      return 0;
+    for (size_t i = 0; i < n; ++i)
+      if (a[i] != b[i])
+        return 0;
+    return 1;
+  }
+} ;
+
+int main (int argc, char* argv[])
+{
+  const char * textfile = (argc > 1) ? argv[1] : "english.txt";
+  size_t numRandom = (argc > 2) ? (size_t)atol(argv[2]) : 1000000;
+  Checker checker;
+  size_t before;
+
+  // every token of the text
+  std::ifstream in(textfile);
+  if (!in)
+  {
+    std::cerr << " ** cannot open " << textfile << '\n';
+    return EXIT_FAILURE;
+  }
+  fsu::String token;
+  before = checker.Tests();
+  while (in >> token)
+    checker.Check(token.Cstr(), token.Size());
+  in.close();
+  std::cout << "tokens of " << textfile << ": " << checker.Tests() - before << '\n';
+
+  // random byte strings, NUL and high-bit bytes included
+  std::mt19937 rng(20170220);
+  char buf[24];
+  before = checker.Tests();
+  for (size_t t = 0; t < numRandom; ++t)
+  {
+    size_t n = rng() % (sizeof(buf) + 1);
+    for (size_t i = 0; i < n; ++i)
+      buf[i] = (char)(rng() & 0xFF);
+    checker.Check(buf, n);
+  }
+  std::cout << "random byte strings: " << checker.Tests() - before << '\n';
+
+  // every short string over the rule alphabet
+  const char alphabet[] = "aZ07\\'-.,:#";
+  const size_t letters = sizeof(alphabet) - 1, maxLength = 6;
+  size_t digit[maxLength];
+  before = checker.Tests();
+  for (size_t n = 0; n <= maxLength; ++n)
+  {
+    for (size_t i = 0; i < n; ++i)
+      digit[i] = 0;
+    for (;;)
+    {
+      for (size_t i = 0; i < n; ++i)
+        buf[i] = alphabet[digit[i]];
+      checker.Check(buf, n);
+      size_t i = 0;
+      while (i < n && ++digit[i] == letters) // next string, as an odometer
+        digit[i++] = 0;
+      if (i == n)
+        break;
+    }
+  }
+  std::cout << "strings over the rule alphabet: " << checker.Tests() - before << '\n';
+
+  std::cout << checker.Tests() << " tests, " << checker.Mismatches() << " mismatches\n";
+  return checker.Mismatches() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
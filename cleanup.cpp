@@ -5,7 +5,10 @@
    This file implements the "Cleanup" function contained in the wordsmith.h header file.  It is included separately for easy use in future applications.
  
    The cleanup function is passed a string which may contain junk characters.  It follows the following rules to clean it out
-   then re-wraps back into a string.
+   in a single pass over the string.  Characters are classified through a 256-entry table rather than the ctype
+   functions, and the cleaned word is written over the original (a String is shortened with SetSize only when the
+   cleaned word is shorter).  The overload taking a character range writes the cleaned word into a caller's buffer
+   instead, so ReadText can clean words straight out of the input without building a String for each one.
  
    Cleanup rules
    -------------
@@ -31,56 +34,118 @@
    -ch is the first or second of a pair of colons, the pair surrounded by letters or digits
  */
 
-#include <cctype>
-#include <cstdlib>
+#include <cstring> // memchr
 
-void WordSmith::Cleanup(fsu::String &s)
-{
-    size_t length = s.Length();
-    char newCharString[length + 1]; //create array to store new cleaned values of string; length is at most the same as input
+// Character classes for the cleanup rules, looked up one byte at a time. The classes follow
+// the "C" locale, which WordSmith runs in: only ASCII letters and digits are alphanumeric.
+enum CleanupClass { JUNK, ALPHA, DIGIT, JOIN, COMMA, COLON }; //JOIN: backslash, apostrophe, hyphen, period
 
-    size_t charArrayIndex = 0;
-    size_t n = 0; //set value to 0 to start
-    fsu::String cleanedString; //declare cleanString
+class CleanupTable
+{
+public:
+    unsigned char kind  [256];
+    char          lower [256];
     
-    //skip leading junk loop - checks for leading character conditions
-    while (
-           !(s.Element(n) == '\0' ||
-             isalpha(s.Element(n)) ||
-             isdigit(s.Element(n)) ||
-             s.Element(n) == '\\' ||
-             (s.Element(n) == '-' && isdigit(s.Element(n+1))) ||
-             (s.Element(n) == ':' && s.Element(n+1) == ':' && isalnum(s.Element(n+2)))
-            ) && (n < length)
-          ) // end condition check
+    CleanupTable ()
     {
-        ++n; //iterate through junk characters
+        for (int c = 0; c < 256; ++c)
+        {
+            kind[c] = JUNK;
+            lower[c] = (char)c;
+        }
+        for (int c = 'a'; c <= 'z'; ++c)
+            kind[c] = ALPHA;
+        for (int c = 'A'; c <= 'Z'; ++c)
+        {
+            kind[c] = ALPHA;
+            lower[c] = (char)(c - 'A' + 'a');
+        }
+        for (int c = '0'; c <= '9'; ++c)
+            kind[c] = DIGIT;
+        kind[(unsigned char)'\\'] = kind[(unsigned char)'\''] = kind[(unsigned char)'-'] = kind[(unsigned char)'.'] = JOIN;
+        kind[(unsigned char)','] = COMMA;
+        kind[(unsigned char)':'] = COLON;
     }
     
-    //at this point the acceptance threshold has been hit
-    //now, decide whether to keep each character, if yes add to cleanString
+    bool IsAlnum (unsigned char c) const { return kind[c] == ALPHA || kind[c] == DIGIT; }
+    bool IsDigit (unsigned char c) const { return kind[c] == DIGIT; }
+};
+
+static const CleanupTable cleanupTable;
+
+size_t WordSmith::Cleanup(const char* s, size_t length, char* out)
+{
+    if (length == 0)
+        return 0;
+    const char* nul = (const char*)memchr(s, '\0', length); //a String ends at its first null character
+    if (nul != nullptr)
+        length = nul - s;
+    
+    const CleanupTable& t = cleanupTable;
+    const unsigned char* u = (const unsigned char*)s;
+    size_t n = 0;
+    
+    //skip leading junk: stop at a letter, digit or backslash, a hyphen before a digit,
+    //or a pair of colons before a letter or digit
+    for (; n < length; ++n)
+    {
+        unsigned char c = u[n];
+        if (t.kind[c] == ALPHA || t.kind[c] == DIGIT || c == '\\')
+            break;
+        unsigned char next = (n + 1 < length) ? u[n + 1] : 0;
+        if (c == '-' && t.IsDigit(next))
+            break;
+        if (c == ':' && next == ':' && n + 2 < length && t.IsAlnum(u[n + 2]))
+            break;
+    }
     
-    while (
-           (
-            isalnum(s.Element(n)) ||
-            (s.Element(n) == '\\' && isalnum(s.Element(n+1))) ||
-            (s.Element(n) == '\'' && isalnum(s.Element(n+1))) ||
-            (s.Element(n) == '-' && isalnum(s.Element(n+1)))  ||
-            (s.Element(n) == '.'&& isalnum(s.Element(n+1)))   ||
-            (s.Element(n) == ',' && isdigit(s.Element(n-1)) && isdigit(s.Element(n+1))) ||
-            (s.Element(n) == ':' && isdigit(s.Element(n-1)) && isdigit(s.Element(n+1))) || //colon surrounded by digits
-            (s.Element(n) == ':' && s.Element(n+1) == ':' && isalnum(s.Element(n-1)) && isalnum(s.Element(n+2))) || //first colon in pair, surrounded by letters or digits
-            (s.Element(n) == ':' && s.Element(n-1) == ':' && isalnum(s.Element(n-2)) && isalnum(s.Element(n+1))) || //second colon in pair, surrounded by letters or digits
-            (s.Element(n) == ':' && s.Element(n+1) == ':' && isalnum(s.Element(n+2))) ||  //first colon in leading pair (special case)
-            (s.Element(n) == ':' && s.Element(n-1) == ':' && isalnum(s.Element(n+1)))   //second colon in leading pair, character after is char or digit
-           ) && (n < length)
-          ) // end condition check
+    //keep characters until the first one the rules reject; out may be s, since only
+    //characters ahead of n are read after out[k] is written and prev keeps the one behind
+    unsigned char prev = (n > 0) ? u[n - 1] : 0;
+    size_t k = 0;
+    for (; n < length; ++n)
     {
-        newCharString[charArrayIndex] = tolower(s.Element(n));
-        ++charArrayIndex;
-        ++n; //increment n
+        unsigned char c = u[n];
+        unsigned char next = (n + 1 < length) ? u[n + 1] : 0;
+        bool keep;
+        switch (t.kind[c])
+        {
+            case ALPHA: case DIGIT:
+                keep = 1;
+                break;
+            case JOIN:  //backslash, apostrophe, hyphen or period followed by a letter or digit
+                keep = t.IsAlnum(next);
+                break;
+            case COMMA: //between digits
+                keep = t.IsDigit(prev) && t.IsDigit(next);
+                break;
+            case COLON: //between digits, or either colon of a pair followed by a letter or digit
+                keep = (t.IsDigit(prev) && t.IsDigit(next))
+                    || (next == ':' && n + 2 < length && t.IsAlnum(u[n + 2]))
+                    || (prev == ':' && t.IsAlnum(next));
+                break;
+            default:
+                keep = 0;
+        }
+        if (!keep)
+            break;
+        out[k++] = t.lower[c];
+        prev = c;
     }
     
-    newCharString[charArrayIndex] = '\0'; //add null character to last space
-    s.Wrap(newCharString); //create string from character array
+    return k;
+}
+
+void WordSmith::Cleanup(fsu::String &s)
+{
+    size_t length = s.Length();
+    if (length == 0)
+    {
+        s.Wrap(""); //as the cleaned empty string always was: size 0, not null
+        return;
+    }
+    char* data = &s[0]; //the String's own buffer, rewritten in place
+    size_t n = Cleanup(data, length, data);
+    if (n != s.Size())
+        s.SetSize(n); //keeps the first n characters
 }
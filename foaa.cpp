@@ -17,6 +17,7 @@
 typedef fsu::String KeyType;
 typedef int         DataType;
 const char fill = '-';
+const size_t dumpDepth = 6, dumpNodes = 63; // limits for the bounded dumps
 // */
 
 template < typename T >
@@ -227,6 +228,10 @@ int main(int argc, char* argv[])
       case '1': aa.Dump(std::cout); break;
       case '2': aa.Dump(std::cout,dw1); break;
       case '3': aa.Dump(std::cout,dw1,fill); break;
+      case '4': aa.DumpBW(std::cout,dumpDepth,dumpNodes); break;
+      case '5': aa.Dump(std::cout,dw1,fill,dumpDepth,dumpNodes); break;
+      case '6': aa.DumpShape(std::cout); break;
+      case '7': aa.DumpDot(std::cout); break;
       default: std::cout << " ** undefined command (level 2)\n";
       }
       break;
@@ -341,6 +346,10 @@ void DisplayMenu(std::ostream& os)
      << "   x.Dump(cout) .................. D1\n"
      << "   x.Dump(cout,ofc) .............. D2\n"
      << "   x.Dump(cout,ofc,fill) ......... D3\n"
+     << "   x.DumpBW(cout,depth,nodes) .... D4\n"
+     << "   x.Dump(cout,ofc,fill,d,n) ..... D5\n"
+     << "   x.DumpShape(cout) ............. D6\n"
+     << "   x.DumpDot(cout) ............... D7\n"
      << "   Size test  .................... S\n"
      << "   traversal  .................... T\n"
      << "   Rehash  ....................... H\n"
@@ -0,0 +1,92 @@
+/*
+    hashfunctions.h
+    Andrew J Wood
+
+    Hash function objects for keys stored in fsu containers.
+
+    Hash<K> defers to std::hash<K> for built-in key types. The specialization
+    for fsu::String is FNV-1a over the characters of the String, so that keys
+    can be hashed without constructing a std::string.
+
+    Hashable<K>::value says whether Hash<K> can hash a K: true for fsu::String
+    and for any K with a usable std::hash<K>. OptionalHash<K> is Hash<K> when
+    it can, and otherwise a placeholder that is never called, so a container
+    that hashes only for optional speedups still compiles for other keys.
+*/
+
+#ifndef _HASHFUNCTIONS_H
+#define _HASHFUNCTIONS_H
+
+#include <cstddef>     // size_t
+#include <functional>  // std::hash
+#include <utility>     // std::declval
+#include <xstring.h>   // fsu::String
+
+namespace fsu
+{
+
+  template < typename K >
+  class Hash
+  {
+  public:
+    size_t operator () (const K& k) const
+    {
+      return std::hash<K>()(k);
+    }
+  } ;
+
+  template <>
+  class Hash < String >
+  {
+  public:
+    size_t operator () (const String& s) const
+    {
+      // 64-bit FNV-1a; an empty String hashes to the offset basis
+      unsigned long long h = 14695981039346656037ULL;
+      const char* p = s.Cstr();
+      if (p != nullptr)
+      {
+        for (; *p != '\0'; ++p)
+        {
+          h ^= (unsigned char)*p;
+          h *= 1099511628211ULL;
+        }
+      }
+      return (size_t)h;
+    }
+  } ;
+
+  template < typename K >
+  class Hashable
+  {
+  private:
+    template < typename T >
+    static char Test (decltype(std::hash<T>()(std::declval<const T&>()))*);
+    template < typename T >
+    static long Test (...);
+  public:
+    static const bool value = sizeof(Test<K>(nullptr)) == sizeof(char);
+  } ;
+
+  template <>
+  class Hashable < String >
+  {
+  public:
+    static const bool value = true;
+  } ;
+
+  template < typename K , bool = Hashable<K>::value >
+  class OptionalHash : public Hash<K>
+  {
+  } ;
+
+  template < typename K >
+  class OptionalHash < K , false >
+  {
+  public:
+    size_t operator () (const K&) const { return 0; } // placeholder; never called
+  } ;
+
+} // namespace fsu
+
+#endif
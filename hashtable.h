@@ -0,0 +1,617 @@
+/*
+ hashtable.h
+ Andrew J Wood
+
+ This header file defines fsu::HashTable<K,D,P,H>, an associative array implemented as an
+ open-addressing hash table with linear probing. It offers the same API as fsu::OAA<K,D,P> so
+ that clients such as WordSmith can switch containers with a typedef: Get(), operator[] and
+ Erase() cost O(1) expected time and compare keys only when their stored hashes match, where the
+ tree pays O(log n) key comparisons.
+
+ Order is needed only by Traverse() and Display(). They walk a sorted view of the table, an array
+ of entry pointers ordered by P, which is built on first use and kept until the next insertion of
+ a new key, Erase(), Clear() or Rehash(); updating the data of an existing key leaves it valid.
+ For key types with a KeyPrefix specialization (keytraits.h) the view is built by an LSD radix
+ sort on the key prefixes, with P breaking prefix ties; otherwise it is std::sort under P. Either
+ way Display() lists keys in the same order as OAA<K,D,P>, so its output is byte-identical.
+
+ Each slot stores the full hash of its key (0 marks an empty slot), and the home slot of a key is
+ taken from the high bits of its hash times a Fibonacci constant, so weak hashes such as
+ std::hash<int> still spread. The table doubles when it would pass 70% full. Erase() removes the
+ entry by shifting later members of its probe run back (no tombstones), so Size() is exact and
+ Rehash() only shrinks the table to fit.
+
+ Keys are equal when neither is P-less than the other. Slots are filled by copy construction,
+ as OAA fills its nodes, since fsu::String assignment and copy differ for the empty String.
+ */
+
+#ifndef FSU_HASHTABLE_H
+#define FSU_HASHTABLE_H
+
+#include <cstddef>    // size_t
+#include <iostream>
+#include <iomanip>
+#include <new>        // std::nothrow
+#include <algorithm>  // std::sort
+#include <compare.h>  // LessThan
+#include <hashfunctions.h> // Hash
+#include <keytraits.h>  // KeyPrefix, used to radix sort the view
+#include <textbuffer.h> // TextBuffer, TextFormat, used by Display()
+
+namespace fsu
+{
+    template < typename K , typename D , class P = LessThan<K> , class H = Hash<K> >
+    class HashTable
+    {
+    public:
+
+        typedef K    KeyType;
+        typedef D    DataType;
+        typedef P    PredicateType;
+
+        HashTable  ();
+        explicit HashTable  (P p);
+        HashTable  (const HashTable& a);
+        ~HashTable ();
+        HashTable& operator=(const HashTable& a);
+
+        DataType& operator [] (const KeyType& k)        { return Get(k); }
+
+        void Put (const KeyType& k , const DataType& d) { Get(k) = d; }
+        D&   Get (const KeyType& k);
+
+        bool Find     (const KeyType& k, DataType& d) const; // d = data of k if present
+        bool Contains (const KeyType& k) const;
+
+        void Erase(const KeyType& k);
+        void Clear();
+        void Rehash(); // shrinks the table to fit Size()
+
+        // replaces the contents with n pairs from next(k, d); sized once for n, so O(n).
+        // Same contract as OAA::Build (increasing key order), which is not checked here
+        template <class G>
+        bool Build (size_t n, G& next);
+
+        // present for OAA compatibility; a hash probe is already O(1)
+        void   SetCache  (size_t) {}
+        size_t CacheSize () const { return 0; }
+
+        bool   Empty    () const { return size_ == 0; }
+        size_t Size     () const { return size_; }
+        size_t Capacity () const { return mask_ ? mask_ + 1 : 0; } // slots
+        size_t EntryBytes () const // table per key, empty slots included; not counting what the key owns
+        {
+            return (sizeof(Entry) + sizeof(size_t)) * (size_ ? Capacity() : 10) / (size_ ? size_ : 7);
+        }
+
+        template <class F>
+        void   Traverse(F f) const;   // f applied to entries in key order
+        template <class F>
+        void   ForEach (F f) const { Traverse(KeyData<F>(f)); } // f(key, data) in key order
+
+        void   Display (std::ostream& os, int kw, int dw,     // key, data widths
+                        std::ios_base::fmtflags kf = std::ios_base::right, // key flag
+                        std::ios_base::fmtflags df = std::ios_base::right // data flag
+        ) const;
+
+        void   Dump (std::ostream& os) const;                 // load and probe lengths
+
+    private: // definitions and relationships
+
+        struct Entry
+        {
+            K  key_;
+            D  data_;
+            Entry () : key_(), data_() {}
+            Entry (const K& k, const D& d) : key_(k), data_(d) {}
+        };
+
+        typedef KeyPrefix<K,P>                PrefixTraits;
+        typedef typename PrefixTraits::PrefixType Prefix;
+
+        template < class F >
+        class KeyData // f(key, data) as a Traverse() function object
+        {
+        public:
+            explicit KeyData (F& f) : f_(f) {}
+            void operator() (const Entry * n) const { f_(n->key_, n->data_); }
+        private:
+            F& f_;
+        };
+
+        class PrintEntry
+        {
+        public:
+            PrintEntry (std::ostream& os, int kw, int dw,
+                        std::ios_base::fmtflags kf, std::ios_base::fmtflags df )
+            : os_(os), kw_(kw), dw_(dw), kf_(kf), df_(df) {}
+            void operator() (const Entry * e) const
+            {
+                os_.setf(kf_,std::ios_base::adjustfield);
+                os_ << std::setw(kw_) << e->key_;
+                os_.setf(df_,std::ios_base::adjustfield);
+                os_ << std::setw(dw_) << e->data_;
+                os_ << '\n';
+            }
+        private:
+            std::ostream& os_;
+            int kw_, dw_;      // key and data column widths
+            std::ios_base::fmtflags kf_, df_; // column adjustment flags for output
+        };
+
+        // PrintEntry through a TextBuffer, for key and data types with a TextFormat
+        class WriteEntry
+        {
+        public:
+            WriteEntry (TextBuffer& tb, int kw, int dw,
+                        std::ios_base::fmtflags kf, std::ios_base::fmtflags df, char fill )
+            : tb_(tb), kw_(kw), dw_(dw), kf_(kf), df_(df), fill_(fill) {}
+            void operator() (const Entry * e) const
+            {
+                char kscratch[TextFormat<K>::Size], dscratch[TextFormat<D>::Size];
+                size_t kn, dn;
+                const char* kt = TextFormat<K>::Text(e->key_, kscratch, kn);
+                const char* dt = TextFormat<D>::Text(e->data_, dscratch, dn);
+                if (kt != nullptr) //else << prints nothing, not even padding
+                    tb_.Field(kt, kn, kw_, kf_, fill_, TextFormat<K>::numeric);
+                if (dt != nullptr)
+                    tb_.Field(dt, dn, dw_, df_, fill_, TextFormat<D>::numeric);
+                tb_.Put('\n');
+            }
+        private:
+            TextBuffer& tb_;
+            int kw_, dw_;
+            std::ios_base::fmtflags kf_, df_;
+            char fill_;
+        };
+
+        // orders entry pointers by key under P
+        class EntryLess
+        {
+        public:
+            explicit EntryLess (const P& p) : pred_(p) {}
+            bool operator() (const Entry * a, const Entry * b) const { return pred_(a->key_, b->key_); }
+        private:
+            const P& pred_;
+        };
+
+        struct Ranked // view entry with its radix key
+        {
+            Prefix        rank;
+            const Entry * entry;
+        };
+
+    private: // data
+        Entry *   table_;
+        size_t *  hashes_;   // hash of the key in each slot; 0 = empty
+        size_t    mask_;     // slots - 1 (a power of 2 - 1), 0 if no table
+        size_t    shift_;    // home slot = (hash * Fibonacci) >> shift_
+        size_t    size_;
+        P         pred_;
+        H         hash_;
+        D         overflow_; // Get() result when the table is full and cannot grow
+
+        mutable const Entry ** view_;      // entries in key order, valid iff viewValid_
+        mutable bool           viewValid_;
+
+    private: // methods
+        size_t Tag   (const K& k) const { size_t h = hash_(k); return h ? h : 1; }
+        size_t Home  (size_t h) const
+        {
+            return (size_t)(((unsigned long long)h * 0x9E3779B97F4A7C15ULL) >> shift_);
+        }
+        bool   Equal (const K& a, const K& b) const { return !pred_(a,b) && !pred_(b,a); }
+        size_t Slot  (const K& k, size_t h) const; // slot holding k, or mask_ + 1
+
+        bool   Resize   (size_t slots); // slots a power of 2 above size_
+        void   Release  ();
+        void   Copy     (const HashTable& a);
+        void   Invalidate () { viewValid_ = 0; }
+        static void Place (Entry& e, const K& k, const D& d) // copy-constructs, as OAA builds its nodes
+        {
+            e.~Entry();
+            new (&e) Entry(k,d);
+        }
+        bool   BuildView () const;
+        void   SortView  (const Entry ** view) const;
+        static void RadixSort (Ranked * a, Ranked * tmp, size_t n);
+    };
+
+    // public API
+
+    template < typename K , typename D , class P , class H >
+    size_t HashTable<K,D,P,H>::Slot (const K& k, size_t h) const
+    {
+        if (mask_ == 0)
+            return 1;
+        for (size_t i = Home(h); hashes_[i] != 0; i = (i + 1) & mask_)
+        {
+            if (hashes_[i] == h && Equal(table_[i].key_, k))
+                return i;
+        }
+        return mask_ + 1;
+    }
+
+    template < typename K , typename D , class P , class H >
+    D& HashTable<K,D,P,H>::Get (const K& k)
+    {
+        size_t h = Tag(k);
+        size_t i = Slot(k, h);
+        if (i <= mask_ && mask_ != 0)
+            return table_[i].data_;
+
+        // new key: grow first if it would pass 70% full
+        if (mask_ == 0 || (size_ + 1) * 10 > (mask_ + 1) * 7)
+        {
+            if (!Resize(mask_ ? 2 * (mask_ + 1) : 16) && (mask_ == 0 || size_ + 1 > mask_))
+            {
+                overflow_ = D(); //no free slot is left: hand back a scratch location
+                return overflow_;
+            }
+        }
+        for (i = Home(h); hashes_[i] != 0; i = (i + 1) & mask_);
+        hashes_[i] = h;
+        Place(table_[i], k, D());
+        ++size_;
+        Invalidate();
+        return table_[i].data_;
+    }
+
+    template < typename K , typename D , class P , class H >
+    bool HashTable<K,D,P,H>::Find (const K& k, D& d) const
+    {
+        size_t i = Slot(k, Tag(k));
+        if (mask_ == 0 || i > mask_)
+            return 0;
+        d = table_[i].data_;
+        return 1;
+    }
+
+    template < typename K , typename D , class P , class H >
+    bool HashTable<K,D,P,H>::Contains (const K& k) const
+    {
+        return mask_ != 0 && Slot(k, Tag(k)) <= mask_;
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Erase (const K& k)
+    {
+        size_t i = Slot(k, Tag(k));
+        if (mask_ == 0 || i > mask_)
+            return;
+        // backward shift: move up each later member of the run that may live at or before i
+        for (size_t j = (i + 1) & mask_; hashes_[j] != 0; j = (j + 1) & mask_)
+        {
+            size_t home = Home(hashes_[j]);
+            if (((j - home) & mask_) >= ((j - i) & mask_))
+            {
+                hashes_[i] = hashes_[j];
+                Place(table_[i], table_[j].key_, table_[j].data_);
+                i = j;
+            }
+        }
+        hashes_[i] = 0;
+        table_[i].~Entry(); //release what the key and data hold
+        new (table_ + i) Entry();
+        --size_;
+        Invalidate();
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Clear ()
+    {
+        Release();
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Rehash ()
+    {
+        if (size_ == 0)
+        {
+            Release();
+            return;
+        }
+        size_t slots = 16;
+        while (size_ * 10 > slots * 7) slots <<= 1;
+        if (slots < mask_ + 1)
+            Resize(slots);
+    }
+
+    template < typename K , typename D , class P , class H >
+    template < class G >
+    bool HashTable<K,D,P,H>::Build (size_t n, G& next)
+    {
+        Clear();
+        size_t slots = 16;
+        while ((n + 1) * 10 > slots * 7) slots <<= 1; //Get() will not grow the table
+        if (n > 0 && !Resize(slots))
+            return 0;
+        K k;
+        D d;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (!next(k, d))
+            {
+                Clear();
+                return 0;
+            }
+            Get(k) = d;
+        }
+        return 1;
+    }
+
+    template < typename K , typename D , class P , class H >
+    template < class F >
+    void HashTable<K,D,P,H>::Traverse (F f) const
+    {
+        if (size_ == 0)
+            return;
+        if (BuildView())
+        {
+            for (size_t i = 0; i < size_; ++i)
+                f(view_[i]);
+            return;
+        }
+        //no memory for a view: find each next key by a linear scan
+        const Entry * last = nullptr;
+        for (size_t n = 0; n < size_; ++n)
+        {
+            const Entry * next = nullptr;
+            for (size_t i = 0; i <= mask_; ++i)
+            {
+                if (hashes_[i] != 0
+                    && (last == nullptr || pred_(last->key_, table_[i].key_))
+                    && (next == nullptr || pred_(table_[i].key_, next->key_)))
+                    next = table_ + i;
+            }
+            f(next);
+            last = next;
+        }
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Display (std::ostream& os, int kw, int dw, std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
+    {
+        if (TextFormat<K>::enabled && TextFormat<D>::enabled && PlainDecimal(os))
+        {   //same bytes as PrintEntry, formatted into a buffer and written in large chunks
+            {
+                TextBuffer tb(os);
+                WriteEntry we(tb, kw, dw, kf, df, os.fill());
+                Traverse(we);
+            }
+            if (size_ > 0) //leave the stream as PrintEntry would
+            {
+                os.setf(df,std::ios_base::adjustfield);
+                os.width(0);
+            }
+            return;
+        }
+        PrintEntry pe(os, kw, dw, kf, df);
+        Traverse(pe);
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Dump (std::ostream& os) const
+    {
+        size_t longest = 0, total = 0;
+        for (size_t i = 0; mask_ != 0 && i <= mask_; ++i)
+        {
+            if (hashes_[i] == 0)
+                continue;
+            size_t d = (i - Home(hashes_[i])) & mask_; //probes past the home slot
+            total += d;
+            if (d > longest) longest = d;
+        }
+        os << "  size:           " << size_ << '\n'
+           << "  slots:          " << Capacity() << '\n';
+        if (size_ > 0)
+        {
+            os << "  load:           " << (100 * size_) / (mask_ + 1) << "%\n"
+               << "  mean probe:     " << 1.0 + (double)total / size_ << '\n'
+               << "  longest probe:  " << 1 + longest << '\n';
+        }
+        os << "  sorted view:    " << (viewValid_ ? "cached" : "not built") << '\n';
+    }
+
+    // proper type
+
+    template < typename K , typename D , class P , class H >
+    HashTable<K,D,P,H>::HashTable ()
+    : table_(nullptr), hashes_(nullptr), mask_(0), shift_(0), size_(0), pred_(), hash_(), overflow_(),
+      view_(nullptr), viewValid_(0)
+    {}
+
+    template < typename K , typename D , class P , class H >
+    HashTable<K,D,P,H>::HashTable (P p)
+    : table_(nullptr), hashes_(nullptr), mask_(0), shift_(0), size_(0), pred_(p), hash_(), overflow_(),
+      view_(nullptr), viewValid_(0)
+    {}
+
+    template < typename K , typename D , class P , class H >
+    HashTable<K,D,P,H>::HashTable (const HashTable& a)
+    : table_(nullptr), hashes_(nullptr), mask_(0), shift_(0), size_(0), pred_(a.pred_), hash_(a.hash_), overflow_(),
+      view_(nullptr), viewValid_(0)
+    {
+        Copy(a);
+    }
+
+    template < typename K , typename D , class P , class H >
+    HashTable<K,D,P,H>::~HashTable ()
+    {
+        Release();
+    }
+
+    template < typename K , typename D , class P , class H >
+    HashTable<K,D,P,H>& HashTable<K,D,P,H>::operator= (const HashTable& a)
+    {
+        if (this != &a)
+        {
+            Release();
+            pred_ = a.pred_;
+            hash_ = a.hash_;
+            Copy(a);
+        }
+        return *this;
+    }
+
+    // private methods
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Copy (const HashTable& a)
+    {
+        if (a.mask_ == 0)
+            return;
+        if (!Resize(a.mask_ + 1))
+            return;
+        for (size_t i = 0; i <= mask_; ++i)
+        {
+            hashes_[i] = a.hashes_[i];
+            if (hashes_[i] != 0)
+                Place(table_[i], a.table_[i].key_, a.table_[i].data_);
+        }
+        size_ = a.size_;
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::Release ()
+    {
+        delete [] table_;
+        delete [] hashes_;
+        delete [] view_;
+        table_ = nullptr;
+        hashes_ = nullptr;
+        view_ = nullptr;
+        mask_ = shift_ = size_ = 0;
+        viewValid_ = 0;
+    }
+
+    template < typename K , typename D , class P , class H >
+    bool HashTable<K,D,P,H>::Resize (size_t slots)
+    {
+        Entry *  newtable  = new(std::nothrow) Entry [slots];
+        size_t * newhashes = new(std::nothrow) size_t [slots];
+        if (newtable == nullptr || newhashes == nullptr)
+        {
+            std::cerr << "** HashTable memory allocation failure\n";
+            delete [] newtable;
+            delete [] newhashes;
+            return 0;
+        }
+        size_t newshift = 64;
+        for (size_t s = slots; s > 1; s >>= 1) --newshift;
+        for (size_t i = 0; i < slots; ++i)
+            newhashes[i] = 0;
+
+        Entry *  oldtable  = table_;
+        size_t * oldhashes = hashes_;
+        size_t   oldslots  = mask_ ? mask_ + 1 : 0;
+        table_  = newtable;
+        hashes_ = newhashes;
+        mask_   = slots - 1;
+        shift_  = newshift;
+        for (size_t j = 0; j < oldslots; ++j)
+        {
+            if (oldhashes[j] == 0)
+                continue;
+            size_t i = Home(oldhashes[j]);
+            while (hashes_[i] != 0) i = (i + 1) & mask_;
+            hashes_[i] = oldhashes[j];
+            Place(table_[i], oldtable[j].key_, oldtable[j].data_);
+        }
+        delete [] oldtable;
+        delete [] oldhashes;
+        delete [] view_; //it points into the old table
+        view_ = nullptr;
+        Invalidate();
+        return 1;
+    }
+
+    template < typename K , typename D , class P , class H >
+    bool HashTable<K,D,P,H>::BuildView () const
+    {
+        if (viewValid_)
+            return 1;
+        if (view_ == nullptr)
+        {   //sized for the table, so it is reused until the table is resized
+            view_ = new(std::nothrow) const Entry* [mask_ + 1];
+            if (view_ == nullptr)
+            {
+                std::cerr << "** HashTable memory allocation failure\n";
+                return 0;
+            }
+        }
+        size_t n = 0;
+        for (size_t i = 0; i <= mask_; ++i)
+        {
+            if (hashes_[i] != 0)
+                view_[n++] = table_ + i;
+        }
+        SortView(view_);
+        viewValid_ = 1;
+        return 1;
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::SortView (const Entry ** view) const
+    {
+        EntryLess less(pred_);
+        Ranked * a = nullptr, * tmp = nullptr;
+        if (PrefixTraits::enabled && size_ > 64)
+        {
+            a   = new(std::nothrow) Ranked [size_];
+            tmp = new(std::nothrow) Ranked [size_];
+        }
+        if (a == nullptr || tmp == nullptr)
+        {
+            delete [] a;
+            delete [] tmp;
+            std::sort(view, view + size_, less);
+            return;
+        }
+
+        // radix keys ascend in P order: complement them when Less() is descending
+        Prefix lo = 0, hi = ~(Prefix)0;
+        bool flip = PrefixTraits::Less(hi, lo);
+        for (size_t i = 0; i < size_; ++i)
+        {
+            Prefix p = PrefixTraits::Make(view[i]->key_);
+            a[i].rank  = flip ? ~p : p;
+            a[i].entry = view[i];
+        }
+        RadixSort(a, tmp, size_);
+        for (size_t i = 0; i < size_; ++i)
+            view[i] = a[i].entry;
+        // keys with equal prefixes are ordered by P
+        for (size_t i = 0, j; i < size_; i = j)
+        {
+            for (j = i + 1; j < size_ && a[j].rank == a[i].rank; ++j);
+            if (j - i > 1)
+                std::sort(view + i, view + j, less);
+        }
+        delete [] a;
+        delete [] tmp;
+    }
+
+    template < typename K , typename D , class P , class H >
+    void HashTable<K,D,P,H>::RadixSort (Ranked * a, Ranked * tmp, size_t n)
+    // stable LSD sort on rank, one byte per pass; passes where every rank has the same byte are skipped
+    {
+        for (size_t shift = 0; shift < 8 * sizeof(Prefix); shift += 8)
+        {
+            size_t count[257] = { 0 };
+            for (size_t i = 0; i < n; ++i)
+                ++count[1 + (size_t)((a[i].rank >> shift) & 0xFF)];
+            if (count[1 + (size_t)((a[0].rank >> shift) & 0xFF)] == n)
+                continue;
+            for (size_t b = 1; b < 257; ++b)
+                count[b] += count[b - 1];
+            for (size_t i = 0; i < n; ++i)
+                tmp[count[(size_t)((a[i].rank >> shift) & 0xFF)]++] = a[i];
+            for (size_t i = 0; i < n; ++i)
+                a[i] = tmp[i];
+        }
+    }
+
+} // namespace fsu
+
+#endif
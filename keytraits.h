@@ -0,0 +1,79 @@
+/*
+    keytraits.h
+    Andrew J Wood
+
+    Key traits used by the OAA tree descent.
+
+    KeyPrefix<K,P> describes a fixed-size, order-preserving prefix of a key
+    under the predicate P. When a specialization sets enabled = true, OAA keeps
+    the prefix inside each node and compares prefixes first during descent; the
+    full keys are compared only when the prefixes tie. The primary template
+    turns the hook off, so OAA behaves as before for every other key type.
+
+    Requirements on an enabled specialization:
+      Less(Make(a), Make(b))  implies  P()(a,b)
+      Make(a) != Make(b)      implies  a != b
+*/
+
+#ifndef _KEYTRAITS_H
+#define _KEYTRAITS_H
+
+#include <climits>    // CHAR_MIN
+#include <compare.h>  // LessThan, GreaterThan
+#include <xstring.h>  // fsu::String
+
+namespace fsu
+{
+
+  template < typename K , class P >
+  class KeyPrefix
+  {
+  public:
+    typedef unsigned char PrefixType; // placeholder; never compared
+    static const bool enabled = false;
+    static PrefixType Make (const K&)                    { return 0; }
+    static bool       Less (PrefixType , PrefixType )    { return 0; }
+  } ;
+
+  // first 8 characters of a String, packed big-endian so that integer order
+  // matches String::StrCmp() order (including the signedness of char)
+  class StringPrefix
+  {
+  public:
+    typedef unsigned long long PrefixType;
+    static PrefixType Make (const String& s)
+    {
+      const unsigned char bias = (CHAR_MIN < 0) ? 0x80 : 0x00;
+      const char* p = s.Cstr();
+      PrefixType x = 0;
+      size_t i = 0;
+      if (p != nullptr)
+      {
+        for (; i < sizeof(PrefixType) && p[i] != '\0'; ++i)
+          x = (x << 8) | (unsigned char)((unsigned char)p[i] ^ bias);
+      }
+      for (; i < sizeof(PrefixType); ++i) // pad with the (biased) terminator
+        x = (x << 8) | bias;
+      return x;
+    }
+  } ;
+
+  template <>
+  class KeyPrefix < String , LessThan<String> > : public StringPrefix
+  {
+  public:
+    static const bool enabled = true;
+    static bool Less (PrefixType a, PrefixType b) { return a < b; }
+  } ;
+
+  template <>
+  class KeyPrefix < String , GreaterThan<String> > : public StringPrefix
+  {
+  public:
+    static const bool enabled = true;
+    static bool Less (PrefixType a, PrefixType b) { return b < a; }
+  } ;
+
+} // namespace fsu
+
+#endif
@@ -36,11 +36,21 @@ int main( int argc, char* argv[] )
   char selection;
   fsu::String filename;
   fsu::String last_report;
+  size_t threads = 1;
+  size_t numfiles = 0;
+  size_t topk = 0;
+  size_t ngram = 0;
+  size_t megabytes = 0;
+  bool indexing = 0;
+  fsu::String word;
+  fsu::List<fsu::String> filenames;
   std::ifstream ifs;
   do
   {
     std::cout <<   "\nWS command ('m' for menu, 'q' to exit): ";
     *isptr >> selection;
+    if (!*isptr) //end of input
+      break;
     if (BATCH) std::cout << selection << '\n';
     switch (selection)
     {
@@ -70,6 +80,31 @@ int main( int argc, char* argv[] )
         }
         break;
        
+      case 'i': case 'I':
+        if (!BATCH)
+        {
+          std::cout << "    ** Standard input holds the commands in interactive mode\n";
+          break;
+        }
+        if (!ws.ReadStream(0, "stdin", selection == 'I'))
+          std::cout << "    ** Cannot read standard input\n";
+        break;
+
+      case 'p': case 'P':
+        std::cout << "  Enter number of files : ";
+        *isptr >> numfiles;
+        if (BATCH) std::cout << numfiles << '\n';
+        filenames.Clear();
+        for (size_t i = 0; i < numfiles; ++i)
+        {
+          std::cout << "  Enter file name " << i + 1 << " : ";
+          *isptr >> filename;
+          if (BATCH) std::cout << filename << '\n';
+          filenames.PushBack(filename);
+        }
+        ws.ReadTexts(filenames, selection == 'P');
+        break;
+
       case 'w': case 'W': 
         std::cout << "  Enter file name: ";
         *isptr >> filename;
@@ -84,6 +119,147 @@ int main( int argc, char* argv[] )
         last_report = filename;
         break;
 
+      case 'b': case 'B':
+        std::cout << "  Enter file name: ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        while (!ws.WriteFrequencyReport(filename)) //file or memory: both are reported
+        {
+          std::cout << "    ** Cannot write report to " << filename << '\n'
+                    << "    Try another file name: ";
+          *isptr >> filename;
+          if (BATCH) std::cout << filename << '\n';
+          if (!*isptr) //no more input to retry with
+            break;
+        }
+        last_report = filename;
+        break;
+
+      case 'k': case 'K':
+        std::cout << "  Enter number of words : ";
+        *isptr >> topk;
+        if (BATCH) std::cout << topk << '\n';
+        std::cout << "  Enter file name: ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        while (!ws.WriteTopK(topk, filename))
+        {
+          std::cout << "    ** Cannot open file " << filename << '\n'
+                    << "    Try another file name: ";
+          *isptr >> filename;
+          if (BATCH) std::cout << filename << '\n';
+        }
+        last_report = filename;
+        break;
+
+      case 'o': case 'O':
+        std::cout << "  Enter number of top words to keep while reading (0 = off): ";
+        *isptr >> topk;
+        if (BATCH) std::cout << topk << '\n';
+        ws.TrackTopK(topk);
+        if (ws.TrackedTopK() > 0)
+          std::cout << "     Keeping the top " << ws.TrackedTopK() << " words\n";
+        else
+          std::cout << "     Not keeping top words\n";
+        break;
+
+      case 'n': case 'N':
+        std::cout << "  Enter n-gram length (2 or 3; 0 = off): ";
+        *isptr >> ngram;
+        if (BATCH) std::cout << ngram << '\n';
+        megabytes = 0;
+        if (ngram > 0)
+        {
+          std::cout << "  Enter n-gram table memory in MB : ";
+          *isptr >> megabytes;
+          if (BATCH) std::cout << megabytes << '\n';
+        }
+        if (!ws.SetNGrams(ngram, megabytes))
+          std::cout << "    ** Cannot count " << ngram << "-grams\n";
+        if (ws.NGrams() > 0)
+          std::cout << "     Counting " << ws.NGrams() << "-grams from now on\n";
+        else
+          std::cout << "     Not counting n-grams\n";
+        break;
+
+      case 'g': case 'G':
+        std::cout << "  Enter number of n-grams : ";
+        *isptr >> topk;
+        if (BATCH) std::cout << topk << '\n';
+        std::cout << "  Enter file name: ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        while (!ws.WriteNGramReport(topk, filename))
+        {
+          std::cout << "    ** Cannot open file " << filename << '\n'
+                    << "    Try another file name: ";
+          *isptr >> filename;
+          if (BATCH) std::cout << filename << '\n';
+        }
+        last_report = filename;
+        break;
+
+      case 'a': case 'A':
+        std::cout << "  Enter sketch memory in MB (0 = exact counting): ";
+        *isptr >> megabytes;
+        if (BATCH) std::cout << megabytes << '\n';
+        topk = 0;
+        if (megabytes > 0)
+        {
+          std::cout << "  Enter number of top words to keep : ";
+          *isptr >> topk;
+          if (BATCH) std::cout << topk << '\n';
+        }
+        if (!ws.SetApproximate(megabytes, topk))
+          std::cout << "    ** Cannot switch to approximate counting\n";
+        if (ws.Approximate())
+          std::cout << "     Counting approximately, keeping the top " << ws.TrackedTopK() << " words\n";
+        else
+          std::cout << "     Counting exactly\n";
+        break;
+
+      case 'e': case 'E':
+        std::cout << "  Index words while reading (1 = on, 0 = off): ";
+        *isptr >> indexing;
+        if (BATCH) std::cout << indexing << '\n';
+        ws.SetIndexing(indexing);
+        if (ws.Indexing())
+          std::cout << "     Indexing words from now on\n";
+        else
+          std::cout << "     Not indexing words\n";
+        break;
+
+      case 'h': case 'H':
+        std::cout << "  Enter word : ";
+        *isptr >> word;
+        if (BATCH) std::cout << word << '\n';
+        if (!ws.ShowOccurrences(word))
+          std::cout << "    ** Not indexing words -- use 'e' to start\n";
+        break;
+
+      case 'j': case 'J':
+        std::cout << "  Enter first word : ";
+        *isptr >> word;
+        if (BATCH) std::cout << word << '\n';
+        std::cout << "  Enter second word : ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        if (!ws.ShowCommon(word, filename))
+          std::cout << "    ** Not indexing words -- use 'e' to start\n";
+        break;
+
+      case 'u': case 'U':
+        std::cout << "  Enter word table memory limit in MB (0 = no limit): ";
+        *isptr >> megabytes;
+        if (BATCH) std::cout << megabytes << '\n';
+        if (!ws.SetMemoryLimit(megabytes))
+          std::cout << "    ** Cannot change the word table memory limit\n";
+        if (ws.MemoryLimit() > 0)
+          std::cout << "     Spilling words to disk past " << ws.MemoryLimit() << " MB\n";
+        else
+          std::cout << "     No limit on word table memory\n";
+        break;
+
       case 'f': case 'F':
         if (last_report.Size() == 0)
         {
@@ -103,6 +279,22 @@ int main( int argc, char* argv[] )
         ifs.clear();
         break;
 
+      case 'v': case 'V':
+        std::cout << "  Enter state file name: ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        if (!ws.SaveState(filename))
+          std::cout << "    ** Cannot write file " << filename << '\n';
+        break;
+
+      case 'l': case 'L':
+        std::cout << "  Enter state file name: ";
+        *isptr >> filename;
+        if (BATCH) std::cout << filename << '\n';
+        if (!ws.LoadState(filename))
+          std::cout << "    ** Cannot load file " << filename << '\n';
+        break;
+
       case 'c': case 'C':
         ws.ClearData();
         std::cout << "\n     Current data erased\n";
@@ -111,6 +303,14 @@ int main( int argc, char* argv[] )
       case 's': case 'S':
         ws.ShowSummary();
         break;
+
+      case 't': case 'T':
+        std::cout << "  Enter number of read threads (0 = all cores): ";
+        *isptr >> threads;
+        if (BATCH) std::cout << threads << '\n';
+        ws.SetThreads(threads);
+        std::cout << "     Reading with " << ws.Threads() << " thread(s)\n";
+        break;
      
       case 'm': case 'M':
         DisplayMenu();
@@ -156,9 +356,26 @@ void DisplayMenu()
             << "     ----------                              ---\n"
             << "     read a file  .........................  'r'\n"
             << "     Read a file with progress reports  ...  'R'\n"
+            << "     read standard input (BATCH mode)  ....  'i'\n"
+            << "     Read standard input with progress  ...  'I'\n"
+            << "     read files in parallel  ..............  'p'\n"
+            << "     Read files in parallel with progress .  'P'\n"
             << "     show summary  ........................  's'\n"
             << "     write report  ........................  'w'\n"
+            << "     write report by frequency  ...........  'b'\n"
+            << "     write top k words report  ............  'k'\n"
+            << "     write top n-grams report  ............  'g'\n"
             << "     show last report file to screen ......  'f'\n"
+            << "     set read threads  ....................  't'\n"
+            << "     keep top k words while reading  ......  'o'\n"
+            << "     count n-grams while reading  .........  'n'\n"
+            << "     approximate / exact counting  ........  'a'\n"
+            << "     limit word table memory  .............  'u'\n"
+            << "     index words while reading  ...........  'e'\n"
+            << "     show where a word occurs  ............  'h'\n"
+            << "     show files holding two words  ........  'j'\n"
+            << "     save state  ..........................  'v'\n"
+            << "     load state  ..........................  'l'\n"
             << "     clear current data  ..................  'c'\n"
             << "     exit BATCH mode  .....................  'x'\n"
             << "     display menu  ........................  'm'\n"
@@ -0,0 +1,314 @@
+/*
+    ngram.h
+    Andrew J Wood
+
+    Word n-gram counting in bounded memory.
+
+    Words are interned by WordIds (wordids.h), so that an n-gram can be kept
+    as the fixed-width tuple of its word IDs (NGram) instead of as the text of
+    its words.
+
+    NGramTable counts n-grams of IDs in a compact open-addressing table of
+    24-byte entries (linear probing, no tombstones) that grows by doubling
+    up to a size fixed by a memory budget, and never past it. When the table
+    is as full as the budget allows, it is pruned by lossy counting: every
+    entry is stamped with Floor() when it is made, and a prune raises Floor()
+    and drops each entry whose count plus stamp does not pass it, until at
+    most half the allowed entries are left. A kept count is then low by at
+    most Floor(), and a dropped n-gram occurred at most Floor() times before
+    it was dropped; Floor() stays 0, and every count is exact, as long as the
+    n-grams fit. Dropped() is the number of occurrences discarded this way.
+
+    NGramCounter ties the two together for a stream of words: Add() appends
+    a word and counts the n-gram that ends with it, and Restart() begins a
+    new text, so n-grams never span two texts. NGramOrder orders n-grams
+    alphabetically, word by word, for ties in a report.
+*/
+
+#ifndef _NGRAM_H
+#define _NGRAM_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+#include <xstring.h>  // fsu::String
+#include <hashfunctions.h> // Hash
+#include <wordids.h>  // WordIds
+
+namespace fsu
+{
+
+  struct NGram
+  {
+    static const size_t MaxOrder = 3;
+    uint32_t id[MaxOrder]; // word IDs; places past the order are 0
+  } ;
+
+  template <>
+  class Hash < NGram >
+  {
+  public:
+    size_t operator () (const NGram& g) const
+    {
+      unsigned long long x = ((unsigned long long)g.id[1] << 32 | g.id[0]) ^ (g.id[2] * 0x9E3779B97F4A7C15ULL);
+      x ^= x >> 33; x *= 0xFF51AFD7ED558CCDULL; // murmur3 finalizer
+      x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ULL;
+      x ^= x >> 33;
+      return (size_t)x;
+    }
+  } ;
+
+  class NGramTable
+  {
+  public:
+    NGramTable  () : table_(nullptr), order_(0), mask_(0), size_(0), maxSlots_(0),
+                     total_(0), dropped_(0), floor_(0) {}
+    ~NGramTable () { delete [] table_; }
+
+    bool   Reset   (size_t order, size_t budget); // empty; table of at most budget bytes
+    void   Add     (const NGram& g);              // counts one occurrence of g
+
+    size_t Order   () const { return order_; }
+    size_t Size    () const { return size_; }     // distinct n-grams kept
+    unsigned long long Total   () const { return total_; }   // occurrences counted
+    unsigned long long Dropped () const { return dropped_; } // occurrences discarded by pruning
+    unsigned long long Floor   () const { return floor_; }   // bound on the error of a kept count
+
+    template < class F >
+    void   ForEach (F f) const;  // f(gram, count) for each kept n-gram, in table order
+
+  private:
+    struct Entry
+    {
+      NGram              gram;
+      uint32_t           stamp;  // Floor() when the entry was made
+      unsigned long long count;  // 0 = empty slot
+    };
+
+    Entry *  table_;
+    size_t   order_, mask_, size_, maxSlots_;
+    unsigned long long total_, dropped_, floor_;
+
+    static bool Same (const NGram& a, const NGram& b)
+    {
+      return a.id[0] == b.id[0] && a.id[1] == b.id[1] && a.id[2] == b.id[2];
+    }
+    size_t Limit  () const { return (mask_ + 1) / 10 * 7; } // entries allowed in the current table
+    size_t Slot   (const NGram& g) const;  // slot holding g, or the empty one that would
+    bool   Grow   ();                      // false at the budget, or if out of memory
+    void   Prune  ();
+    void   Settle ();                      // re-seats entries after a prune emptied slots
+
+    NGramTable (const NGramTable&);            // not copyable
+    NGramTable& operator = (const NGramTable&);
+  } ;
+
+  inline bool NGramTable::Reset (size_t order, size_t budget)
+  {
+    delete [] table_;
+    table_ = nullptr;
+    order_ = mask_ = size_ = maxSlots_ = 0;
+    total_ = dropped_ = floor_ = 0;
+    if (order == 0)
+      return 1;
+    if (order > NGram::MaxOrder)
+      return 0;
+    size_t maxSlots = 1024;
+    while (maxSlots * 2 * sizeof(Entry) <= budget) maxSlots *= 2;
+    table_ = new(std::nothrow) Entry [1024];
+    if (table_ == nullptr)
+    {
+      std::cerr << "** NGramTable memory allocation failure\n";
+      return 0;
+    }
+    for (size_t i = 0; i < 1024; ++i)
+      table_[i].count = 0;
+    order_ = order;
+    mask_ = 1023;
+    maxSlots_ = maxSlots;
+    return 1;
+  }
+
+  inline size_t NGramTable::Slot (const NGram& g) const
+  {
+    size_t i = Hash<NGram>()(g) & mask_;
+    while (table_[i].count != 0 && !Same(table_[i].gram, g))
+      i = (i + 1) & mask_;
+    return i;
+  }
+
+  inline bool NGramTable::Grow ()
+  {
+    size_t slots = mask_ + 1;
+    if (slots >= maxSlots_)
+      return 0;
+    Entry * bigger = new(std::nothrow) Entry [2 * slots];
+    if (bigger == nullptr) // the budget is more than there is: stay at this size
+    {
+      maxSlots_ = slots;
+      return 0;
+    }
+    for (size_t i = 0; i < 2 * slots; ++i)
+      bigger[i].count = 0;
+    Entry * old = table_;
+    table_ = bigger;
+    mask_ = 2 * slots - 1;
+    for (size_t i = 0; i < slots; ++i)
+    {
+      if (old[i].count != 0)
+        table_[Slot(old[i].gram)] = old[i];
+    }
+    delete [] old;
+    return 1;
+  }
+
+  inline void NGramTable::Prune ()
+  {
+    do
+    {
+      ++floor_;
+      for (size_t i = 0; i <= mask_; ++i)
+      {
+        Entry& e = table_[i];
+        if (e.count != 0 && e.count + e.stamp <= floor_)
+        {
+          dropped_ += e.count;
+          e.count = 0;
+          --size_;
+        }
+      }
+    }
+    while (size_ > Limit() / 2);
+    Settle();
+  }
+
+  // Starting just past an empty slot, each entry in turn is lifted out and put back at the
+  // first empty slot from its home. Entries before it in its probe run are already settled,
+  // so it lands no later than where it was.
+  inline void NGramTable::Settle ()
+  {
+    size_t start = 0;
+    while (table_[start].count != 0) ++start; // there is one: Limit() < slots
+    for (size_t n = 1; n <= mask_; ++n)
+    {
+      size_t i = (start + n) & mask_;
+      if (table_[i].count == 0)
+        continue;
+      Entry e = table_[i];
+      table_[i].count = 0;
+      table_[Slot(e.gram)] = e;
+    }
+  }
+
+  inline void NGramTable::Add (const NGram& g)
+  {
+    ++total_;
+    size_t i = Slot(g);
+    if (table_[i].count != 0)
+    {
+      ++table_[i].count;
+      return;
+    }
+    if (size_ >= Limit())
+    {
+      if (!Grow())
+        Prune();
+      i = Slot(g);
+    }
+    table_[i].gram = g;
+    table_[i].stamp = (floor_ < 0xFFFFFFFFu) ? (uint32_t)floor_ : 0xFFFFFFFFu;
+    table_[i].count = 1;
+    ++size_;
+  }
+
+  template < class F >
+  void NGramTable::ForEach (F f) const
+  {
+    for (size_t i = 0; order_ > 0 && i <= mask_; ++i)
+    {
+      if (table_[i].count != 0)
+        f(table_[i].gram, table_[i].count);
+    }
+  }
+
+  class NGramCounter
+  {
+  public:
+    NGramCounter () : ids_(), table_(), window_(), filled_(0), budget_(0) {}
+
+    bool   SetOrder (size_t n, size_t budget); // counts n-grams, n = 2 or 3, in budget bytes; 0 = off
+    size_t Order    () const { return table_.Order(); }
+    void   Restart  () { filled_ = 0; }        // the next word begins a new text
+    void   Add      (const String& word);
+    void   Clear    () { SetOrder(Order(), budget_); } // forgets all counts
+
+    const WordIds&    Words () const { return ids_; }
+    const NGramTable& Table () const { return table_; }
+
+  private:
+    WordIds    ids_;
+    NGramTable table_;
+    NGram      window_; // IDs of the last filled_ words
+    size_t     filled_;
+    size_t     budget_;
+
+    NGramCounter (const NGramCounter&);            // not copyable
+    NGramCounter& operator = (const NGramCounter&);
+  } ;
+
+  inline bool NGramCounter::SetOrder (size_t n, size_t budget)
+  {
+    if (n == 1 || n > NGram::MaxOrder)
+      return 0;
+    ids_.Clear();
+    filled_ = 0;
+    budget_ = budget;
+    for (size_t i = 0; i < NGram::MaxOrder; ++i)
+      window_.id[i] = 0;
+    return table_.Reset(n, budget);
+  }
+
+  inline void NGramCounter::Add (const String& word)
+  {
+    size_t order = table_.Order();
+    if (order == 0)
+      return;
+    uint32_t id = ids_.Id(word);
+    if (id == WordIds::NoId) // an n-gram with a word that has no ID cannot be counted
+    {
+      filled_ = 0;
+      return;
+    }
+    if (filled_ == order)
+    {
+      for (size_t i = 1; i < order; ++i)
+        window_.id[i - 1] = window_.id[i];
+      --filled_;
+    }
+    window_.id[filled_++] = id;
+    if (filled_ == order)
+      table_.Add(window_);
+  }
+
+  class NGramOrder
+  {
+  public:
+    NGramOrder (const WordIds& words, size_t order) : words_(&words), order_(order) {}
+    bool operator () (const NGram& a, const NGram& b) const
+    {
+      for (size_t i = 0; i < order_; ++i)
+      {
+        if (a.id[i] != b.id[i])
+          return words_->Word(a.id[i]) < words_->Word(b.id[i]);
+      }
+      return 0;
+    }
+  private:
+    const WordIds * words_;
+    size_t          order_;
+  } ;
+
+} // namespace fsu
+
+#endif
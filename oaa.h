@@ -10,6 +10,18 @@
  with the exception of the Rehash() function, which will be Thetat(n log n).  The RBLLT structure is
  what ensures the log n runtimes; the rehash fucntion is n log n because it requires a full tree
  traversal and new tree creation.
+
+ Optional features, each described further at its methods:
+ A hot-key cache (SetCache()) lets repeated Get()s of frequent keys skip the tree descent.
+ For key types with a KeyPrefix (keytraits.h) each node holds an ordered prefix of its key,
+ so the descent rarely dereferences a full key.
+ A Bloom filter (SetBloom()) answers most Find() and Contains() queries for absent keys.
+ BatchGet() and BatchUpdate() search a sorted range of keys from a finger, not the root.
+ The TopDownInsert policy inserts in one iterative pass, splitting 4-nodes on the way down.
+ SetEraseMode() chooses between tombstones (the default) and left-leaning red-black deletion.
+ Display() writes through a reusable TextBuffer (textbuffer.h) when the types allow it.
+ Bounded and shape-only dumps cost O(nodes shown) where the grid dumps cost O(2^height).
+ OpenLog() attaches a group-committed write-ahead log with snapshots (oplog.h).
  */
 
 #ifndef _OAA_H
@@ -18,16 +30,27 @@
 #include <cstddef>    // size_t
 #include <iostream>
 #include <iomanip>
+#include <sstream>    // used in DumpDot()
 #include <compare.h>  // LessThan
+#include <hashfunctions.h> // Hash, used by the hot-key cache and the Bloom filter
+#include <keytraits.h> // KeyPrefix, used by the descent
+#include <bloomfilter.h> // BloomFilter, used by Find() and Contains()
+#include <serial.h>   // Serial, ByteBuffer, used by the log
+#include <oplog.h>    // OpLog
+#include <textbuffer.h> // TextBuffer, TextFormat, used by Display()
 #include <queue.h>    // used in Dump()
 #include <ansicodes.h>
 
 namespace fsu
 {
-    template < typename K , typename D , class P >
+    // insertion policies
+    class BottomUpInsert {}; // recursive descent, repairs as the recursion unwinds (2-3 tree)
+    class TopDownInsert  {}; // single pass, 4-nodes split on the way down (2-3-4 tree)
+    
+    template < typename K , typename D , class P , class I >
     class OAA;
     
-    template < typename K , typename D , class P = LessThan<K> >
+    template < typename K , typename D , class P = LessThan<K> , class I = BottomUpInsert >
     class OAA
     {
     public:
@@ -35,6 +58,7 @@ namespace fsu
         typedef K    KeyType;
         typedef D    DataType;
         typedef P    PredicateType;
+        typedef I    InsertPolicy;
         
         OAA  ();
         explicit OAA  (P p);
@@ -44,31 +68,113 @@ namespace fsu
         
         DataType& operator [] (const KeyType& k)        { return Get(k); }
         
-        void Put (const KeyType& k , const DataType& d) { Get(k) = d; }
+        void Put (const KeyType& k , const DataType& d);
         D&   Get (const KeyType& k);
         
+        bool Find     (const KeyType& k, DataType& d) const; // d = data of k, if k is alive
+        bool Contains (const KeyType& k) const;
+        
+        // sorted batches (unsorted input is correct, just slower): Get() each key in
+        // [first,last); BatchGet writes &Get(k) to out, BatchUpdate calls f(Get(k), *dfirst++).
+        // Each search climbs from the previous path (a finger): O(m log(n/m)) for m keys
+        template <class Iter, class Out>
+        void BatchGet    (Iter first, Iter last, Out out);
+        template <class Iter, class DIter, class F>
+        void BatchUpdate (Iter first, Iter last, DIter dfirst, F f);
+        
+        // TOMBSTONE (the default) flags the node dead: Get() revives it with its old data, and
+        // Rehash() reclaims it. REMOVE is LLRB deletion; a re-inserted key starts from DataType()
+        enum EraseMode { TOMBSTONE, REMOVE }; // flag the node dead, or delete it from the tree
+        void      SetEraseMode (EraseMode m) { eraseMode_ = m; }
+        EraseMode GetEraseMode () const      { return eraseMode_; }
+        
         void Erase(const KeyType& k);
         void Clear();
         void Rehash();
         
+        // replaces the contents with n pairs from next(k, d), which must give them in strictly
+        // increasing key order; builds a balanced tree in O(n) time. False, leaving the table
+        // empty, if next() fails or the keys are out of order
+        template <class G>
+        bool Build (size_t n, G& next);
+        
+        // write-ahead log (oplog.h), off by default. OpenLog() recovers the table from
+        // base.snap and base.log, replacing its contents, or snapshots the current contents
+        // when neither exists; from then on Put, inserting Get, Erase, Clear and BatchUpdate
+        // are logged. Writes through the reference Get() returns are not: use Put().
+        bool   OpenLog    (const char* base, size_t groupBytes = 65536, unsigned groupMillis = 50,
+                           size_t compactBytes = 64 * 1024 * 1024);
+        bool   SyncLog    ();  // commit the buffered records now
+        bool   Checkpoint ();  // fold the table, tombstones too, into base.snap and empty the log
+        void   CloseLog   ();  // commit and stop logging
+        bool   Logging    () const { return log_ != nullptr; }
+        
         bool   Empty    () const { return root_ == nullptr; }
         size_t Size     () const { return RSize(root_); }     // counts alive nodes
         size_t NumNodes () const { return RNumNodes(root_); } // counts nodes
+        size_t EntryBytes () const { return sizeof(Node); }   // structure per key, not counting what the key owns
         int    Height   () const { return RHeight(root_); }
         
+        // hot-key cache: a direct-mapped table of key -> node for repeated Get()s of frequent keys;
+        // slots is rounded up to a power of 2; 0 turns the cache off. Keys without a Hash
+        // (Hashable<K>, hashfunctions.h) have no cache: it stays off
+        void   SetCache  (size_t slots);
+        size_t CacheSize () const { return cache_ ? cacheMask_ + 1 : 0; }
+        
+        // Bloom filter for Find/Contains: about 1% false positives at 10 bits per key; 0 turns it off.
+        // Erased keys stay in it; Rehash(), Clear() and outgrowing it rebuild it from the tree.
+        // Like the cache, it stays off for keys without a Hash
+        void   SetBloom  (size_t bitsPerKey);
+        size_t BloomBitsPerKey () const { return bloomBitsPerKey_; }
+        
+        struct Statistics
+        {
+            size_t cacheHits;           // Get() answered from the cache
+            size_t cacheMisses;         // Get() that fell through to tree descent
+            size_t bloomNegatives;      // Find/Contains answered "absent" by the filter alone
+            size_t bloomFalsePositives; // filter said "maybe", tree said absent
+            Statistics() : cacheHits(0), cacheMisses(0), bloomNegatives(0), bloomFalsePositives(0) {}
+            double CacheHitRate() const
+            {
+                size_t probes = cacheHits + cacheMisses;
+                return probes ? (double)cacheHits / probes : 0.0;
+            }
+            double BloomFalsePositiveRate() const // among lookups of absent keys
+            {
+                size_t misses = bloomNegatives + bloomFalsePositives;
+                return misses ? (double)bloomFalsePositives / misses : 0.0;
+            }
+        };
+        const Statistics& Stats () const { return stats_; }
+        void   ResetStats ()              { stats_ = Statistics(); }
+        
         template <class F>
         void   Traverse(F f) const { RTraverse(root_,f); }
+        template <class F>
+        void   ForEach (F f) const { Traverse(KeyData<F>(f)); } // f(key, data) for alive keys in key order
         
+        // through a TextBuffer when K and D have a TextFormat and os prints plain decimal,
+        // otherwise by PrintNode; the output is the same
         void   Display (std::ostream& os, int kw, int dw,     // key, data widths
                         std::ios_base::fmtflags kf = std::ios_base::right, // key flag
                         std::ios_base::fmtflags df = std::ios_base::right // data flag
         ) const;
         
+        // grid dumps: every position of the complete tree, so O(2^height)
         void   DumpBW (std::ostream& os) const;
         void   Dump (std::ostream& os) const;
         void   Dump (std::ostream& os, int kw) const;
         void   Dump (std::ostream& os, int kw, char fill) const;
         
+        // bounded dumps: the top maxDepth levels, stopping before a level that would take
+        // the positions shown (fills included) past maxNodes; cost O(positions shown)
+        void   DumpBW (std::ostream& os, size_t maxDepth, size_t maxNodes) const;
+        void   Dump (std::ostream& os, int kw, char fill, size_t maxDepth, size_t maxNodes) const;
+        
+        // shape exports, linear in the number of nodes
+        void   DumpShape (std::ostream& os) const; // preorder, B/b/R/r(left,right), '-' = no child
+        void   DumpDot (std::ostream& os, size_t maxDepth = ~(size_t)0) const; // Graphviz digraph
+        
     private: // definitions and relationships
         
         enum Flags { ZERO = 0x00 , DEAD = 0x01, RED = 0x02 , DEFAULT = RED }; // DEFAULT = alive,red
@@ -96,16 +202,20 @@ namespace fsu
             }
         }
         
+        typedef KeyPrefix<K,P>                    PrefixTraits;
+        typedef typename PrefixTraits::PrefixType Prefix;
+        
         class Node
         {
+            const Prefix    prefix_; // ordered prefix of key_, compared first
             const KeyType   key_;
             DataType  data_;
             Node * lchild_, * rchild_;
             uint8_t flags_; //8 bit value
             Node (const KeyType& k, const DataType& d, Flags flags = DEFAULT) // Flags = RED, Alive
-            : key_(k), data_(d), lchild_(nullptr), rchild_(nullptr), flags_(flags)
+            : prefix_(PrefixTraits::Make(k)), key_(k), data_(d), lchild_(nullptr), rchild_(nullptr), flags_(flags)
             {}
-            friend class OAA<K,D,P>;
+            friend class OAA<K,D,P,I>;
             bool IsRed    () const { return 0 != (RED & flags_); }
             bool IsBlack  () const { return !IsRed(); }
             bool IsDead   () const { return 0 != (DEAD & flags_); }
@@ -134,6 +244,16 @@ namespace fsu
             
         };
         
+        template < class F >
+        class KeyData // f(key, data) as a Traverse() function object
+        {
+        public:
+            explicit KeyData (F& f) : f_(f) {}
+            void operator() (const Node * n) const { if (n->IsAlive()) f_(n->key_, n->data_); }
+        private:
+            F& f_;
+        };
+        
         class PrintNode
         {
         public:
@@ -158,35 +278,113 @@ namespace fsu
             //stream
         };
         
+        // PrintNode through a TextBuffer, for key and data types with a TextFormat
+        class WriteNode
+        {
+        public:
+            WriteNode (TextBuffer& tb, int kw, int dw,
+                       std::ios_base::fmtflags kf, std::ios_base::fmtflags df, char fill, size_t& rows )
+            : tb_(tb), kw_(kw), dw_(dw), kf_(kf), df_(df), fill_(fill), rows_(rows) {}
+            void operator() (const Node * n) const
+            {
+                if (n->IsAlive())
+                {
+                    char kscratch[TextFormat<K>::Size], dscratch[TextFormat<D>::Size];
+                    size_t kn, dn;
+                    const char* kt = TextFormat<K>::Text(n->key_, kscratch, kn);
+                    const char* dt = TextFormat<D>::Text(n->data_, dscratch, dn);
+                    if (kt != nullptr) //else << prints nothing, not even padding
+                        tb_.Field(kt, kn, kw_, kf_, fill_, TextFormat<K>::numeric);
+                    if (dt != nullptr)
+                        tb_.Field(dt, dn, dw_, df_, fill_, TextFormat<D>::numeric);
+                    tb_.Put('\n');
+                    ++rows_;
+                }
+            }
+        private:
+            TextBuffer& tb_;
+            int kw_, dw_;
+            std::ios_base::fmtflags kf_, df_;
+            char fill_;
+            size_t& rows_;
+        };
+        
         class CopyNode
         {
         public:
-            CopyNode (Node*& newroot, OAA<K,D>* oaa) : newroot_(newroot), oldtree_(oaa) {}
+            CopyNode (Node*& newroot, OAA<K,D,P,I>* oaa) : newroot_(newroot), oldtree_(oaa) {}
             void operator() (const Node * n) const
             {
                 if (n->IsAlive())
                 {
-                    newroot_ = oldtree_->RInsert(newroot_,n->key_, n->data_);
+                    newroot_ = oldtree_->RInsert(newroot_,n->key_, n->prefix_, n->data_);
                     newroot_->SetBlack();
                 }
             }
         private:
-            Node *&    newroot_;
-            OAA<K,D> * oldtree_;
+            Node *&      newroot_;
+            OAA<K,D,P,I> * oldtree_;
+        };
+        
+        class SnapNode
+        {
+        public:
+            SnapNode (OpLog& log, bool& ok) : log_(log), ok_(ok) {}
+            void operator() (const Node * n) const
+            {
+                if (ok_) //dead nodes too: Get() revives them with their data
+                {
+                    ByteBuffer& b = log_.SnapshotBuffer();
+                    ok_ = Serial<K>::Write(b, n->key_) && Serial<D>::Write(b, n->data_) && b.Put((char)n->IsAlive());
+                    if (ok_ && b.Size() >= 65536)
+                        ok_ = log_.FlushSnapshot();
+                }
+            }
+        private:
+            OpLog&  log_;
+            bool&   ok_;
+        };
+        
+        class BloomNode
+        {
+        public:
+            BloomNode (BloomFilter& bf, const OptionalHash<K>& h) : bf_(bf), hash_(h) {}
+            void operator() (const Node * n) const
+            {
+                bf_.Insert(hash_(n->key_)); //dead nodes too: Get() may resurrect them
+            }
+        private:
+            BloomFilter&    bf_;
+            const OptionalHash<K>& hash_;
         };
         
     private: // data
         Node *         root_;
         PredicateType  pred_;
+        OptionalHash<K> hash_;     // used only when Hashable<K>
+        Node **        cache_;     // hot-key cache slots, nullptr when disabled
+        size_t         cacheMask_; // number of slots - 1
+        BloomFilter    bloom_;
+        size_t         bloomBitsPerKey_; // 0 when the filter is off
+        mutable Statistics stats_; // updated by const lookups
+        EraseMode      eraseMode_;
+        OpLog *        log_;       // write-ahead log, nullptr when off
         
     private: // methods
         static Node * NewNode     (const K& k, const D& d, Flags flags = DEFAULT);
         static void   RRelease    (Node* n); // deletes all descendants of n
+        static void   RDelete     (Node* n) { RRelease(n); delete n; } // n and its descendants
         static Node * RClone      (const Node* n); // returns deep copy of n
         static size_t RSize       (Node * n);
         static size_t RNumNodes   (Node * n);
         static int    RHeight     (Node * n);
         
+        // Build(): a subtree of n pairs from next() with the given black height, as a 2-3 tree
+        template < class G >
+        Node * RBuild   (size_t n, int height, G& next, const Node*& last, bool& ok);
+        template < class G >
+        Node * NextNode (G& next, Flags flags, const Node*& last, bool& ok);
+        
         // rotations
         static Node * RotateLeft  (Node * n);
         static Node * RotateRight (Node * n);
@@ -194,11 +392,103 @@ namespace fsu
         template < class F >
         static void   RTraverse (Node * n, F f);
         
+        // shared by the bounded dumps: BWMap cells, or colored keys in columns of width kw
+        void   DumpRows  (std::ostream& os, bool bw, int kw, char fill, size_t maxDepth, size_t maxNodes) const;
+        static void   RShape (std::ostream& os, const Node * n);
+        static size_t RDot   (std::ostream& os, const Node * n, size_t& id, size_t depth, size_t maxDepth);
+        
+        // descent comparisons: prefixes decide unless they tie, then the full keys
+        bool IsLess    (const K& k, Prefix kp, const Node * n) const // k < n->key_
+        {
+            if (PrefixTraits::enabled && kp != n->prefix_)
+                return PrefixTraits::Less(kp, n->prefix_);
+            return pred_(k, n->key_);
+        }
+        bool IsGreater (const K& k, Prefix kp, const Node * n) const // n->key_ < k
+        {
+            if (PrefixTraits::enabled && kp != n->prefix_)
+                return PrefixTraits::Less(n->prefix_, kp);
+            return pred_(n->key_, k);
+        }
+        
+        // iterative lookup; returns the node holding k, alive or dead, or nullptr
+        const Node * FindNode (const K& k) const;
+        
+        // the search path of the previous batch key, reused by the next one
+        struct Finger
+        {
+            enum { MaxDepth = 16 * sizeof(size_t) }; // LLRB height <= 2 lg n
+            Node *       path[MaxDepth + 1]; // path[0] is root_
+            const Node * hi[MaxDepth + 1];   // nearest ancestor bounding path[i] from above, or nullptr
+            bool         left[MaxDepth + 1]; // direction taken below path[i]
+            size_t       depth;              // number of valid levels
+            const Node * last;               // node found for the previous key
+            Finger () : depth(0), last(nullptr) {}
+        };
+        Node * FingerGet (Finger& f, const K& k);
+        
+        // the three LLRB repairs applied on the way up by RGet and FingerGet
+        static Node * FixUp (Node * nptr);
+        
+        // returns the node holding k, inserting it if necessary, by insertion policy
+        Node * Insert (const K& k, BottomUpInsert);
+        Node * Insert (const K& k, TopDownInsert);
+        static bool RepairsUpward (BottomUpInsert) { return 1; }
+        static bool RepairsUpward (TopDownInsert)  { return 0; }
+        
         // recursive left-leaning get
-        Node * RGet(Node* nptr, const K& kval, Node*& location);
+        Node * RGet(Node* nptr, const K& kval, Prefix kp, Node*& location);
         
         // recursive left-leaning insert
-        Node * RInsert(Node* nptr, const K& key, const D& data);
+        Node * RInsert(Node* nptr, const K& key, Prefix kp, const D& data);
+        
+        // recursive left-leaning delete; k must be in the subtree. RRemoveMin unlinks
+        // the minimum node without deleting it and returns it in min
+        Node * RRemove    (Node* nptr, const K& k, Prefix kp);
+        Node * RRemoveMin (Node* nptr, Node*& min);
+        static Node * MoveRedLeft  (Node * nptr);
+        static Node * MoveRedRight (Node * nptr);
+        static Node * RemoveFixUp  (Node * nptr);
+        static void   FlipColors   (Node * nptr);
+        
+        // hot-key cache helpers
+        Node * CacheFind  (const K& k);
+        void   CacheStore (const K& k, Node * n);
+        void   CacheErase (const K& k);
+        void   CacheFlush ();
+        
+        // rebuild the Bloom filter from the tree, sized from its node count
+        void   BloomRebuild ();
+        
+        // bookkeeping for a key Get() creates or revives: Bloom filter and log
+        void   Created (const K& k)
+        {
+            if (bloom_.Active())
+                bloom_.Insert(hash_(k));
+            if (log_ != nullptr)
+                LogKey('G', k);
+        }
+        void   Revive  (Node * n)
+        {
+            if (n->IsDead())
+            {
+                n->SetAlive();
+                if (log_ != nullptr)
+                    LogKey('G', n->key_);
+            }
+        }
+        
+        // log records: 'G' key (Get insert), 'P' key data, 'E' key, 'C'
+        void   LogKey  (char type, const K& k)  { Serial<K>::Write(log_->Begin(type), k); log_->End(); }
+        void   LogPut  (const K& k, const D& d)
+        {
+            ByteBuffer& b = log_->Begin('P');
+            Serial<K>::Write(b, k);
+            Serial<D>::Write(b, d);
+            log_->End();
+        }
+        bool   Replay  (OpLog& log); // applies the recovered snapshot and records
+        void   ClearTree ();         // Clear() without the log record
         
     }; // class OAA<>
     
@@ -206,124 +496,768 @@ namespace fsu
     // API
     
     //1//
-    template < typename K , typename D , class P >
-    D& OAA<K,D,P>::Get (const KeyType& k)
+    template < typename K , typename D , class P , class I >
+    D& OAA<K,D,P,I>::Get (const KeyType& k)
     {
         //returns reference to data value assoated with k; inserts if necessary
+        Node * location = CacheFind(k); //hot keys skip the descent
+        if (location)
+        {
+            Revive(location); //same resurrection rule as RGet
+            return location->data_;
+        }
+        location = Insert(k, InsertPolicy()); //find location of key, inserting if necessary
+        CacheStore(k,location);
+        if (bloom_.Active() && bloom_.Count() > bloom_.Capacity()) //inserts have outgrown the filter
+            BloomRebuild();
+        if (log_ != nullptr && log_->CompactDue())
+            Checkpoint();
+        return location->data_; //returns node's data as a reference
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::Insert (const K& k, BottomUpInsert)
+    {
         Node * location;
-        root_ = RGet(root_,k,location); //use recursive get to find location of key
+        root_ = RGet(root_,k,PrefixTraits::Make(k),location); //use recursive get to find location of key
         root_ -> SetBlack(); //root is always black
-        return location->data_; //returns node's data as a reference
+        return location;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::Insert (const K& k, TopDownInsert)
+    // Single top-down pass. A red node c (a freshly split 4-node, or the new leaf) can
+    // only break the tree against its parent p, and p's parent g is then black: any
+    // 4-node above c was split on the way down, and the halves of a split have black
+    // children, so no further split happens within two levels of it. Hence clink, plink
+    // and glink (the links holding c, p and g) are all the state the repairs need.
+    {
+        Prefix kp = PrefixTraits::Make(k);
+        Node ** clink = &root_, ** plink = nullptr, ** glink = nullptr;
+        Node * location = nullptr;
+        while (location == nullptr)
+        {
+            Node * c = *clink;
+            if (c == nullptr) // bottom: new red leaf
+            {
+                c = location = NewNode(k, D());
+                Created(k);
+                *clink = c;
+            }
+            else if (c->LeftChildIsRed() && c->RightChildIsRed()) // split 4-node
+            {
+                c->lchild_->SetBlack();
+                c->rchild_->SetBlack();
+                c->SetRed();
+            }
+            
+            // a red c may clash with its parent
+            if (c->IsRed() && plink != nullptr)
+            {
+                Node * p = *plink;
+                if (p->IsBlack())
+                {
+                    if (c == p->rchild_ && !p->LeftChildIsRed()) // lean left
+                    {
+                        *plink = RotateLeft(p);
+                        clink = plink;
+                        plink = glink;
+                        glink = nullptr;
+                    }
+                }
+                else if (c == p->lchild_) // p red, so p is g's left; left-left reds
+                {
+                    *glink = RotateRight(*glink);
+                    clink = &(*glink)->lchild_;
+                    plink = glink;
+                    glink = nullptr;
+                }
+                else // p red, c its right child: lean left, then as above
+                {
+                    *plink = RotateLeft(p);
+                    *glink = RotateRight(*glink);
+                    clink = glink;
+                    plink = glink = nullptr;
+                }
+            }
+            
+            if (location != nullptr)
+                break;
+            c = *clink;
+            if (IsLess(k, kp, c))
+            {
+                glink = plink; plink = clink; clink = &c->lchild_;
+            }
+            else if (IsGreater(k, kp, c))
+            {
+                glink = plink; plink = clink; clink = &c->rchild_;
+            }
+            else
+            {
+                location = c;
+                Revive(location); //same resurrection rule as RGet
+            }
+        }
+        root_->SetBlack(); //root is always black
+        return location;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::Find (const KeyType& k, DataType& d) const
+    {
+        const Node * n = FindNode(k);
+        if (n == nullptr || n->IsDead())
+            return 0;
+        d = n->data_;
+        return 1;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::Contains (const KeyType& k) const
+    {
+        const Node * n = FindNode(k);
+        return n != nullptr && n->IsAlive();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    const typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::FindNode (const K& k) const
+    {
+        if (bloom_.Active() && !bloom_.MayContain(hash_(k)))
+        {
+            ++stats_.bloomNegatives; //definite miss; the tree is not touched
+            return nullptr;
+        }
+        const Node * n = root_;
+        Prefix kp = PrefixTraits::Make(k);
+        while (n)
+        {
+            if (IsLess(k, kp, n))
+                n = n->lchild_;
+            else if (IsGreater(k, kp, n))
+                n = n->rchild_;
+            else
+                break;
+        }
+        if (bloom_.Active() && (n == nullptr || n->IsDead()))
+            ++stats_.bloomFalsePositives;
+        return n;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    template < class Iter , class Out >
+    void OAA<K,D,P,I>::BatchGet (Iter first, Iter last, Out out)
+    {
+        Finger f;
+        for (; first != last; ++first, ++out)
+            *out = &FingerGet(f, *first)->data_;
+        if (bloom_.Active() && bloom_.Count() > bloom_.Capacity())
+            BloomRebuild();
+        if (log_ != nullptr && log_->CompactDue())
+            Checkpoint();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    template < class Iter , class DIter , class F >
+    void OAA<K,D,P,I>::BatchUpdate (Iter first, Iter last, DIter dfirst, F f)
+    {
+        Finger fg;
+        for (; first != last; ++first, ++dfirst)
+        {
+            Node * n = FingerGet(fg, *first);
+            f(n->data_, *dfirst);
+            if (log_ != nullptr) //the update is known here, so it is logged as a Put
+                LogPut(n->key_, n->data_);
+        }
+        if (bloom_.Active() && bloom_.Count() > bloom_.Capacity())
+            BloomRebuild();
+        if (log_ != nullptr && log_->CompactDue())
+            Checkpoint();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::FingerGet (Finger& f, const K& k)
+    // Get() that starts from the finger; leaves the finger on the path to k
+    {
+        Prefix kp = PrefixTraits::Make(k);
+        if (f.depth == 0 || root_ == nullptr || IsLess(k, kp, f.last)) //out of order: restart at the root
+        {
+            f.path[0] = root_;
+            f.hi[0] = nullptr;
+            f.depth = 1;
+        }
+        // climb to the deepest level whose subtree can hold k; keys only grow, so only
+        // the upper bounds matter, and they change only where the path turned left
+        size_t l = f.depth - 1;
+        while (l > 0 && f.hi[l] != nullptr && !IsLess(k, kp, f.hi[l]))
+        {
+            const Node * bound = f.hi[l];
+            while (l > 0 && f.hi[l] == bound) --l;
+        }
+        
+        // descend
+        Node * n = f.path[l];
+        while (n != nullptr)
+        {
+            if (IsLess(k, kp, n))
+            {
+                f.left[l] = 1;
+                f.path[l+1] = n = n->lchild_;
+                f.hi[l+1] = f.path[l];
+            }
+            else if (IsGreater(k, kp, n))
+            {
+                f.left[l] = 0;
+                f.path[l+1] = n = n->rchild_;
+                f.hi[l+1] = f.hi[l];
+            }
+            else // found; no structural change, the whole path stays valid
+            {
+                Revive(n);
+                f.depth = l + 1;
+                f.last = n;
+                return n;
+            }
+            ++l;
+        }
+        
+        // the upward repairs below assume a 2-3 tree; with 4-nodes present (TopDownInsert)
+        // a new key takes the top-down pass from the root and the finger restarts
+        if (!RepairsUpward(InsertPolicy()))
+        {
+            f.depth = 0;
+            return Insert(k, InsertPolicy());
+        }
+        
+        // insert at level l, then repair upward only while the tree keeps changing
+        Node * location = NewNode(k, D());
+        Created(k);
+        f.path[l] = location;
+        if (l == 0)
+            root_ = location;
+        else if (f.left[l-1])
+            f.path[l-1]->lchild_ = location;
+        else
+            f.path[l-1]->rchild_ = location;
+        
+        size_t valid = 1; // levels of the finger still valid when the repairs stop
+        while (l > 0)
+        {
+            --l;
+            Node * n0 = f.path[l];
+            bool wasRed = n0->IsRed();
+            Node * n1 = FixUp(n0);
+            // the parent looks at our color and, through a left-left red pair, at our
+            // left child; when neither can have changed, nothing above can change
+            if (n1 == n0 && n1->IsRed() == wasRed && !(n1->IsRed() && n1->LeftChildIsRed()))
+            {
+                valid = l + 1;
+                break;
+            }
+            f.path[l] = n1;
+            if (l == 0)
+                root_ = n1;
+            else if (f.left[l-1])
+                f.path[l-1]->lchild_ = n1;
+            else
+                f.path[l-1]->rchild_ = n1;
+        }
+        root_->SetBlack(); //root is always black
+        f.path[0] = root_;
+        f.depth = valid;
+        f.last = location;
+        return location;
     }
     
     //EC//
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Erase(const KeyType& k)
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Erase(const KeyType& k)
     {
         Node * n = root_; // start at root of tree
+        Prefix kp = PrefixTraits::Make(k);
         while(n) //while on a valid node
         {
-            if (pred_(k, n->key_)) //if k is less than current key
+            if (IsLess(k, kp, n)) //if k is less than current key
             {
                 n = n->lchild_; //go left
             }
-            else if (pred_(n->key_, k)) //if k is greater than current key
+            else if (IsGreater(k, kp, n)) //if k is greater than current key
             {
                 n = n->rchild_; //go right
             }
             else //key found
             {
-                n->SetDead();
+                if (log_ != nullptr)
+                    LogKey('E', k);
+                CacheErase(k); //drop it from the cache before the node dies or goes away
+                if (eraseMode_ == TOMBSTONE)
+                {
+                    n->SetDead();
+                    if (log_ != nullptr && log_->CompactDue())
+                        Checkpoint();
+                    return;
+                }
+                if (!root_->LeftChildIsRed() && !root_->RightChildIsRed())
+                    root_->SetRed(); //so the descent can borrow from the root
+                root_ = RRemove(root_, k, kp);
+                if (root_)
+                    root_->SetBlack(); //root is always black
+                if (log_ != nullptr && log_->CompactDue())
+                    Checkpoint();
                 return;
             }
         }
     }
     
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RRemove(Node * nptr, const K& k, Prefix kp)
+    // keeps nptr or one of its children red on the way down, so the node finally
+    // removed is never a lone black node
+    {
+        if (IsLess(k, kp, nptr))
+        {
+            if (!nptr->LeftChildIsRed() && !nptr->lchild_->LeftChildIsRed())
+                nptr = MoveRedLeft(nptr);
+            nptr->lchild_ = RRemove(nptr->lchild_, k, kp);
+        }
+        else
+        {
+            if (nptr->LeftChildIsRed() && !nptr->RightChildIsRed()) //a 4-node already has a red right
+                nptr = RotateRight(nptr);
+            if (nptr->rchild_ == nullptr && !IsGreater(k, kp, nptr)) //found at the bottom
+            {
+                delete nptr;
+                return nullptr;
+            }
+            if (!nptr->RightChildIsRed() && !nptr->rchild_->LeftChildIsRed())
+                nptr = MoveRedRight(nptr);
+            if (IsGreater(k, kp, nptr))
+                nptr->rchild_ = RRemove(nptr->rchild_, k, kp);
+            else //found: the successor takes this node's place (keys are const, so relink)
+            {
+                Node * min;
+                Node * right = RRemoveMin(nptr->rchild_, min);
+                min->lchild_ = nptr->lchild_;
+                min->rchild_ = right;
+                nptr->IsRed() ? min->SetRed() : min->SetBlack();
+                delete nptr;
+                nptr = min;
+            }
+        }
+        return RemoveFixUp(nptr);
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RRemoveMin(Node * nptr, Node*& min)
+    {
+        if (nptr->lchild_ == nullptr)
+        {
+            min = nptr;
+            return nullptr;
+        }
+        if (!nptr->LeftChildIsRed() && !nptr->lchild_->LeftChildIsRed())
+            nptr = MoveRedLeft(nptr);
+        nptr->lchild_ = RRemoveMin(nptr->lchild_, min);
+        return RemoveFixUp(nptr);
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RemoveFixUp(Node * nptr)
+    // FixUp that also rotates a red right child under a red left one, and straightens a
+    // red left child with a red right child, so any 4-node met on the way up is split.
+    // FixUp alone could leave reds leaning right in a tree with 4-nodes (TopDownInsert)
+    {
+        if (nptr->RightChildIsRed())
+            nptr = RotateLeft(nptr);
+        if (nptr->LeftChildIsRed() && nptr->lchild_->RightChildIsRed())
+            nptr->lchild_ = RotateLeft(nptr->lchild_);
+        return FixUp(nptr);
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::MoveRedLeft(Node * nptr)
+    // nptr red, both children black: make the left child or one of its children red
+    {
+        FlipColors(nptr);
+        if (nptr->rchild_->LeftChildIsRed()) //borrow from the right sibling
+        {
+            nptr->rchild_ = RotateRight(nptr->rchild_);
+            nptr = RotateLeft(nptr);
+            FlipColors(nptr);
+            nptr->rchild_ = FixUp(nptr->rchild_); //a sibling that was a 4-node now leans right
+        }
+        return nptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::MoveRedRight(Node * nptr)
+    // nptr red, both children black: make the right child or one of its children red
+    {
+        FlipColors(nptr);
+        if (nptr->lchild_->LeftChildIsRed()) //borrow from the left sibling
+        {
+            nptr = RotateRight(nptr);
+            FlipColors(nptr);
+        }
+        return nptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::FlipColors(Node * nptr)
+    // toggles nptr and both children: merges a 2-3-4 node with its children, or splits it
+    {
+        nptr->IsRed() ? nptr->SetBlack() : nptr->SetRed();
+        nptr->lchild_->IsRed() ? nptr->lchild_->SetBlack() : nptr->lchild_->SetRed();
+        nptr->rchild_->IsRed() ? nptr->rchild_->SetBlack() : nptr->rchild_->SetRed();
+    }
+    
     //2//
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Clear()
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Put (const KeyType& k , const DataType& d)
+    {
+        Get(k) = d;
+        if (log_ != nullptr)
+        {
+            LogPut(k, d);
+            if (log_->CompactDue())
+                Checkpoint();
+        }
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Clear()
+    {
+        if (log_ != nullptr)
+        {
+            log_->Begin('C');
+            log_->End();
+        }
+        ClearTree();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::ClearTree()
     {
         RRelease(root_); //delete all descendents of root
         delete root_; //delete the root itself
         root_ = 0; //set root to 0 (empty tree)
+        CacheFlush(); //every cached node is gone
+        if (bloom_.Active())
+            BloomRebuild();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    template < class G >
+    bool OAA<K,D,P,I>::Build (size_t n, G& next)
+    // a 2-3 tree with all leaves at the same depth, drawn as a left-leaning red-black tree:
+    // the black height is the largest h with 2^h - 1 <= n, and a subtree that holds more
+    // pairs than two children of height h - 1 can becomes a 3-node
+    {
+        Clear();
+        int height = 0;
+        while (((size_t)2 << height) - 1 <= n && height < 8 * (int)sizeof(size_t) - 1)
+            ++height;
+        const Node * last = nullptr;
+        bool ok = 1;
+        root_ = RBuild(n, height, next, last, ok);
+        if (!ok)
+            return 0;
+        if (bloom_.Active())
+            BloomRebuild();
+        if (log_ != nullptr)
+            return Checkpoint(); //the pairs go into the log as a snapshot
+        return 1;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    template < class G >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RBuild (size_t n, int height, G& next, const Node*& last, bool& ok)
+    {
+        if (n == 0 || !ok)
+            return nullptr;
+        if (height == 0) //more pairs than the height allows: not reachable from Build()
+        {
+            ok = 0;
+            return nullptr;
+        }
+        size_t most = 0; //most pairs a child subtree can hold: 3^(height-1) - 1, capped at n
+        for (int h = 1; h < height && most < n; ++h)
+            most = 3 * most + 2;
+        if (n - 1 <= 2 * most) //2-node
+        {
+            Node * l = RBuild((n - 1) / 2, height - 1, next, last, ok);
+            Node * x = NextNode(next, ZERO, last, ok);
+            Node * r = RBuild(n - 1 - (n - 1) / 2, height - 1, next, last, ok);
+            if (!ok)
+            {
+                RDelete(l); RDelete(x); RDelete(r);
+                return nullptr;
+            }
+            x->lchild_ = l;
+            x->rchild_ = r;
+            return x;
+        }
+        //3-node: a black node with a red left child holding the smaller key
+        size_t m = n - 2;
+        Node * a = RBuild(m / 3, height - 1, next, last, ok);
+        Node * red = NextNode(next, RED, last, ok);
+        Node * b = RBuild((m + 1) / 3, height - 1, next, last, ok);
+        Node * x = NextNode(next, ZERO, last, ok);
+        Node * c = RBuild((m + 2) / 3, height - 1, next, last, ok);
+        if (!ok)
+        {
+            RDelete(a); RDelete(red); RDelete(b); RDelete(x); RDelete(c);
+            return nullptr;
+        }
+        red->lchild_ = a;
+        red->rchild_ = b;
+        x->lchild_ = red;
+        x->rchild_ = c;
+        return x;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    template < class G >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::NextNode (G& next, Flags flags, const Node*& last, bool& ok)
+    {
+        if (!ok)
+            return nullptr;
+        K k;
+        D d;
+        if (!next(k, d) || (last != nullptr && !pred_(last->key_, k)))
+        {
+            ok = 0;
+            return nullptr;
+        }
+        Node * x = NewNode(k, d, flags);
+        if (x == nullptr)
+        {
+            ok = 0;
+            return nullptr;
+        }
+        last = x;
+        return x;
     }
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Rehash()
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Rehash()
     { // this is complete!
         Node* newRoot = nullptr;
         CopyNode cn(newRoot,this);
         Traverse(cn);
-        Clear();
+        ClearTree(); //also flushes the cache, which pointed into the old tree
         root_ = newRoot;
+        if (bloom_.Active())
+            BloomRebuild(); //dead keys are gone; resize for the live ones
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::OpenLog (const char* base, size_t groupBytes, unsigned groupMillis, size_t compactBytes)
+    {
+        CloseLog();
+        OpLog * log = new(std::nothrow) OpLog;
+        if (log == nullptr)
+        {
+            std::cerr << "** OAA memory allocation failure\n";
+            return 0;
+        }
+        if (!log->Open(base, groupBytes, groupMillis, compactBytes))
+        {
+            delete log;
+            return 0;
+        }
+        if (log->Recovered() && !Replay(*log))
+        {
+            std::cerr << "** OAA::OpenLog(): cannot replay " << base << " into this table\n";
+            delete log;
+            return 0;
+        }
+        log->ReleaseReplay();
+        log_ = log;
+        return Checkpoint(); //start from a snapshot of what we have; the replayed log is folded in
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::Replay (OpLog& log)
+    // runs the logged operations again, with logging off
+    {
+        ClearTree();
+        size_t n;
+        const char* p = log.SnapshotData(n);
+        const char* end = p + n;
+        K k;
+        D d;
+        while (p != nullptr && p < end) //snapshot: key, data, alive byte for every node
+        {
+            if (!Serial<K>::Read(p, end, k) || !Serial<D>::Read(p, end, d) || p == end)
+                return 0;
+            Node * n = Insert(k, InsertPolicy());
+            n->data_ = d;
+            if (*p++ == 0)
+                n->SetDead();
+        }
+        const char* rec;
+        for (p = log.LogBegin(); OpLog::NextRecord(p, log.LogEnd(), rec, n); )
+        {
+            const char* r = rec + 1;
+            end = rec + n;
+            switch (*rec)
+            {
+                case 'G': if (!Serial<K>::Read(r, end, k)) return 0; Get(k); break;
+                case 'P': if (!Serial<K>::Read(r, end, k) || !Serial<D>::Read(r, end, d)) return 0; Get(k) = d; break;
+                case 'E': if (!Serial<K>::Read(r, end, k)) return 0; Erase(k); break;
+                case 'C': ClearTree(); break;
+                default: return 0;
+            }
+        }
+        return 1;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::SyncLog ()
+    {
+        return log_ != nullptr && log_->Commit();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    bool OAA<K,D,P,I>::Checkpoint ()
+    {
+        if (log_ == nullptr)
+            return 0;
+        bool ok = log_->BeginSnapshot();
+        if (ok)
+        {
+            SnapNode sn(*log_, ok);
+            Traverse(sn);
+            ok = ok && log_->EndSnapshot();
+        }
+        if (!log_->Active()) //the log file could not be started again: stop logging
+        {
+            std::cerr << "** OAA: write-ahead log lost; logging stopped\n";
+            CloseLog();
+        }
+        return ok;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::CloseLog ()
+    {
+        delete log_; //commits the last group
+        log_ = nullptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::SetBloom (size_t bitsPerKey)
+    {
+        bloomBitsPerKey_ = Hashable<K>::value ? bitsPerKey : 0;
+        if (bloomBitsPerKey_ == 0)
+            bloom_.Release();
+        else
+            BloomRebuild();
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::BloomRebuild ()
+    {
+        size_t n = NumNodes();
+        if (!bloom_.Reset(2 * n + 64, bloomBitsPerKey_)) //room to double before the next rebuild
+        {
+            bloomBitsPerKey_ = 0; //run without a filter
+            return;
+        }
+        BloomNode bn(bloom_, hash_);
+        Traverse(bn);
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::SetCache (size_t slots)
+    {
+        delete [] cache_;
+        cache_ = nullptr;
+        cacheMask_ = 0;
+        if (slots == 0 || !Hashable<K>::value)
+            return;
+        size_t n = 1;
+        while (n < slots) n <<= 1; //direct-mapped index is hash & mask
+        cache_ = new(std::nothrow) Node* [n];
+        if (cache_ == nullptr)
+        {
+            std::cerr << "** OAA memory allocation failure\n";
+            return; //run without a cache
+        }
+        cacheMask_ = n - 1;
+        CacheFlush();
     }
     
     //3//
-    template < typename K , typename D , class P >
-    void  OAA<K,D,P>::Display (std::ostream& os, int kw, int dw, std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
+    template < typename K , typename D , class P , class I >
+    void  OAA<K,D,P,I>::Display (std::ostream& os, int kw, int dw, std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
     {
+        if (TextFormat<K>::enabled && TextFormat<D>::enabled && PlainDecimal(os))
+        {   //same bytes as PrintNode, formatted into a buffer and written in large chunks
+            size_t rows = 0;
+            {
+                TextBuffer tb(os);
+                WriteNode wn(tb, kw, dw, kf, df, os.fill(), rows);
+                Traverse(wn);
+            }
+            if (rows > 0) //leave the stream as PrintNode would
+            {
+                os.setf(df,std::ios_base::adjustfield);
+                os.width(0);
+            }
+            return;
+        }
         PrintNode pn(os, kw, dw, kf, df);  //create print node object
         Traverse(pn); //traverse using PrintNode function object
     }
     
     //4//
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node * OAA<K,D,P>::RGet(Node* nptr, const K& kval, Node*& location)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RGet(Node* nptr, const K& kval, Prefix kp, Node*& location)
     // recursive left-leaning get; returns node location of found value
     {
         if (nptr == 0) //add new node at "bottom" of tree
         {
             location = NewNode(kval, D()); //note, will use DEFAULT as flags argument (RED and ALIVE)
+            Created(kval);
             return location;
         }
-        if (pred_(kval,nptr->key_)) //if kval < key_ in current node, go to left subtree
+        if (IsLess(kval,kp,nptr)) //if kval < key_ in current node, go to left subtree
         {
-            nptr->lchild_ = RGet(nptr->lchild_,kval,location);
+            nptr->lchild_ = RGet(nptr->lchild_,kval,kp,location);
         }
-        else if (pred_(nptr->key_,kval)) // if kval > key_ in current node, go to right subtree
+        else if (IsGreater(kval,kp,nptr)) // if kval > key_ in current node, go to right subtree
         {
-            nptr->rchild_ = RGet(nptr->rchild_,kval,location);
+            nptr->rchild_ = RGet(nptr->rchild_,kval,kp,location);
         }
         else // the node exists and was found; set location only, don't update value
         {
             location = nptr;
-            nptr -> SetAlive(); //set alive; Get will insert if data is not found, hence if any node
+            Revive(nptr); //set alive; Get will insert if data is not found, hence if any node
                                 //is found containing the data it should be set to alive.
         }
         
         
-        //repair the RBLL properties on the way up
-        if (nptr->RightChildIsRed() && !nptr->LeftChildIsRed()) //if the right child is red but left is not
-            nptr = RotateLeft(nptr); //rotate the tree left around nptr; nptr has replacement
-        if (nptr->LeftChildIsRed() && nptr->lchild_->LeftChildIsRed()) //if there are two consecutive red left ndoes
-            nptr = RotateRight(nptr); //rotate right
-        if (nptr->LeftChildIsRed() && nptr->RightChildIsRed()) //red node has to have only black children
-        {   //swap parent/child colors
-            nptr->lchild_->SetBlack();
-            nptr->rchild_->SetBlack();
-            nptr->SetRed();
-        }
-        
-        return nptr; //returns root location;
+        return FixUp(nptr); //repair the RBLL properties on the way up; returns root location
     }
     
     
     //5//
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node * OAA<K,D,P>::RInsert(Node* nptr, const K& key, const D& data)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RInsert(Node* nptr, const K& key, Prefix kp, const D& data)
     // recursive left-leaning insert; very similar to RGet
     {
         if (nptr == 0) //add new node at "bottom" of tree
         {
             return NewNode(key, data); //note, will use DEFAULT as flags argument (RED)
         }
-        if (pred_(key,nptr->key_)) //if kval < key_ in current node, go to left subtree
+        if (IsLess(key,kp,nptr)) //if kval < key_ in current node, go to left subtree
         {
-            nptr->lchild_ = RInsert(nptr->lchild_,key,data);
+            nptr->lchild_ = RInsert(nptr->lchild_,key,kp,data);
         }
-        else if (pred_(nptr->key_,key)) // if kval > key_ in current node, go to right subtree
+        else if (IsGreater(key,kp,nptr)) // if kval > key_ in current node, go to right subtree
         {
-            nptr->rchild_ = RInsert(nptr->rchild_,key,data);
+            nptr->rchild_ = RInsert(nptr->rchild_,key,kp,data);
         }
         else // the node exists and was found; overwrite data
         {
@@ -331,7 +1265,57 @@ namespace fsu
             nptr->SetAlive(); //set Alive in case it is not already alive
         }
         
-        //repair the RBLL properties on the way up
+        return FixUp(nptr); //repair the RBLL properties on the way up; returns root location
+    }
+    
+    
+    // hot-key cache
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::CacheFind (const K& k)
+    {
+        if (cache_ == nullptr)
+            return nullptr;
+        Node * n = cache_[hash_(k) & cacheMask_];
+        if (n != nullptr && !pred_(k, n->key_) && !pred_(n->key_, k))
+        {
+            ++stats_.cacheHits;
+            return n;
+        }
+        ++stats_.cacheMisses;
+        return nullptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::CacheStore (const K& k, Node * n)
+    {
+        if (cache_ != nullptr)
+            cache_[hash_(k) & cacheMask_] = n; //newest key wins the slot
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::CacheErase (const K& k)
+    {
+        if (cache_ == nullptr)
+            return;
+        Node *& n = cache_[hash_(k) & cacheMask_];
+        if (n != nullptr && !pred_(k, n->key_) && !pred_(n->key_, k))
+            n = nullptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::CacheFlush ()
+    {
+        if (cache_ == nullptr)
+            return;
+        for (size_t i = 0; i <= cacheMask_; ++i)
+            cache_[i] = nullptr;
+    }
+    
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::FixUp(Node * nptr)
+    // repairs the RBLL properties at nptr after a change below it; returns the subtree root
+    {
         if (nptr->RightChildIsRed() && !nptr->LeftChildIsRed()) //if the right child is red but left is not
             nptr = RotateLeft(nptr); //rotate the tree left around nptr; nptr has replacement
         if (nptr->LeftChildIsRed() && nptr->lchild_->LeftChildIsRed()) //if there are two consecutive red left ndoes
@@ -346,46 +1330,54 @@ namespace fsu
         return nptr; //returns root location;
     }
     
-    
     /************************************/
     /* everyting below here is complete */
     
     // proper type
     
-    template < typename K , typename D , class P >
-    OAA<K,D,P>::OAA  () : root_(nullptr), pred_()
+    template < typename K , typename D , class P , class I >
+    OAA<K,D,P,I>::OAA  () : root_(nullptr), pred_(), hash_(), cache_(nullptr), cacheMask_(0), bloom_(), bloomBitsPerKey_(0), stats_(), eraseMode_(TOMBSTONE), log_(nullptr)
     {}
     
-    template < typename K , typename D , class P >
-    OAA<K,D,P>::OAA  (P p) : root_(nullptr), pred_(p)
+    template < typename K , typename D , class P , class I >
+    OAA<K,D,P,I>::OAA  (P p) : root_(nullptr), pred_(p), hash_(), cache_(nullptr), cacheMask_(0), bloom_(), bloomBitsPerKey_(0), stats_(), eraseMode_(TOMBSTONE), log_(nullptr)
     {}
     
-    template < typename K , typename D , class P >
-    OAA<K,D,P>::~OAA ()
+    template < typename K , typename D , class P , class I >
+    OAA<K,D,P,I>::~OAA ()
     {
-        Clear();
+        CloseLog(); //the files keep the table; no Clear record
+        ClearTree();
+        delete [] cache_;
     }
     
-    template < typename K , typename D , class P >
-    OAA<K,D,P>::OAA( const OAA& tree ) : root_(nullptr), pred_(tree.pred_)
+    template < typename K , typename D , class P , class I >
+    OAA<K,D,P,I>::OAA( const OAA& tree ) : root_(nullptr), pred_(tree.pred_), hash_(), cache_(nullptr), cacheMask_(0), bloom_(), bloomBitsPerKey_(0), stats_(), eraseMode_(tree.eraseMode_), log_(nullptr)
     {
         root_ = RClone(tree.root_);
+        SetCache(tree.CacheSize()); //same cache geometry, empty slots
+        SetBloom(tree.BloomBitsPerKey());
     }
     
-    template < typename K , typename D , class P >
-    OAA<K,D,P>& OAA<K,D,P>::operator=( const OAA& that )
+    template < typename K , typename D , class P , class I >
+    OAA<K,D,P,I>& OAA<K,D,P,I>::operator=( const OAA& that )
     {
         if (this != &that)
         {
-            Clear();
+            ClearTree();
             this->root_ = RClone(that.root_);
+            SetCache(that.CacheSize());
+            SetBloom(that.BloomBitsPerKey());
+            eraseMode_ = that.eraseMode_;
+            if (log_ != nullptr) //a logged table snapshots its new contents
+                Checkpoint();
         }
         return *this;
     }
     
     // rotations
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node * OAA<K,D,P>::RotateLeft(Node * n)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RotateLeft(Node * n)
     {
         if (nullptr == n || n->rchild_ == nullptr) return n;
         if (!n->rchild_->IsRed())
@@ -402,8 +1394,8 @@ namespace fsu
         return p;
     }
     
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node * OAA<K,D,P>::RotateRight(Node * n)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::RotateRight(Node * n)
     {
         if (n == nullptr || n->lchild_ == nullptr) return n;
         if (!n->lchild_->IsRed())
@@ -423,22 +1415,22 @@ namespace fsu
     
     // private static recursive methods
     
-    template < typename K , typename D , class P >
-    size_t OAA<K,D,P>::RSize(Node * n)
+    template < typename K , typename D , class P , class I >
+    size_t OAA<K,D,P,I>::RSize(Node * n)
     {
         if (n == nullptr) return 0;
         return (size_t)(n->IsAlive()) + RSize(n->lchild_) + RSize(n->rchild_);
     }
     
-    template < typename K , typename D , class P >
-    size_t OAA<K,D,P>::RNumNodes(Node * n)
+    template < typename K , typename D , class P , class I >
+    size_t OAA<K,D,P,I>::RNumNodes(Node * n)
     {
         if (n == nullptr) return 0;
         return 1 + RNumNodes(n->lchild_) + RNumNodes(n->rchild_);
     }
     
-    template < typename K , typename D , class P >
-    int OAA<K,D,P>::RHeight(Node * n)
+    template < typename K , typename D , class P , class I >
+    int OAA<K,D,P,I>::RHeight(Node * n)
     {
         if (n == nullptr) return -1;
         int lh = RHeight(n->lchild_);
@@ -447,9 +1439,9 @@ namespace fsu
         return 1 + lh;
     }
     
-    template < typename K , typename D , class P >
+    template < typename K , typename D , class P , class I >
     template < class F >
-    void OAA<K,D,P>::RTraverse (Node * n, F f)
+    void OAA<K,D,P,I>::RTraverse (Node * n, F f)
     {
         if (n == nullptr) return;
         RTraverse(n->lchild_,f);
@@ -457,44 +1449,44 @@ namespace fsu
         RTraverse(n->rchild_,f);
     }
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::RRelease(Node* n)
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::RRelease(Node* n)
     // post:  all descendants of n have been deleted
     {
         if (n != nullptr)
         {
             if (n->lchild_ != nullptr)
             {
-                OAA<K,D,P>::RRelease(n->lchild_);
+                OAA<K,D,P,I>::RRelease(n->lchild_);
                 delete n->lchild_;
                 n->lchild_ = nullptr;
             }
             if (n->rchild_ != nullptr)
             {
-                OAA<K,D,P>::RRelease(n->rchild_);
+                OAA<K,D,P,I>::RRelease(n->rchild_);
                 delete n->rchild_;
                 n->rchild_ = nullptr;
             }
         }
-    } // OAA<K,D,P>::RRelease()
+    } // OAA<K,D,P,I>::RRelease()
     
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node* OAA<K,D,P>::RClone(const OAA<K,D,P>::Node* n)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node* OAA<K,D,P,I>::RClone(const OAA<K,D,P,I>::Node* n)
     // returns a pointer to a deep copy of n
     {
         if (n == nullptr)
             return 0;
-        typename OAA<K,D,P>::Node* newN = NewNode (n->key_,n->data_);
+        typename OAA<K,D,P,I>::Node* newN = NewNode (n->key_,n->data_);
         newN->flags_ = n->flags_;
-        newN->lchild_ = OAA<K,D,P>::RClone(n->lchild_);
-        newN->rchild_ = OAA<K,D,P>::RClone(n->rchild_);
+        newN->lchild_ = OAA<K,D,P,I>::RClone(n->lchild_);
+        newN->rchild_ = OAA<K,D,P,I>::RClone(n->rchild_);
         return newN;
-    } // end OAA<K,D,P>::RClone() */
+    } // end OAA<K,D,P,I>::RClone() */
     
     
     // private node allocator
-    template < typename K , typename D , class P >
-    typename OAA<K,D,P>::Node * OAA<K,D,P>::NewNode(const K& k, const D& d, Flags flags)
+    template < typename K , typename D , class P , class I >
+    typename OAA<K,D,P,I>::Node * OAA<K,D,P,I>::NewNode(const K& k, const D& d, Flags flags)
     {
         Node * nPtr = new(std::nothrow) Node(k,d,flags);
         if (nPtr == nullptr)
@@ -507,8 +1499,8 @@ namespace fsu
     
     // development assistants
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::DumpBW (std::ostream& os) const
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::DumpBW (std::ostream& os) const
     {
         // fsu::debug ("DumpBW(1)");
         // This is the same as "Dump(1)" except it uses a character map instead of a
@@ -595,8 +1587,8 @@ namespace fsu
         Que.Clear();
     } // DumpBW(os)
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Dump (std::ostream& os) const
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Dump (std::ostream& os) const
     {
         // fsu::debug ("Dump(1)");
         
@@ -687,8 +1679,8 @@ namespace fsu
         Que.Clear();
     } // Dump(os)
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Dump (std::ostream& os, int kw) const
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Dump (std::ostream& os, int kw) const
     {
         // fsu::debug ("Dump(2)");
         if (root_ == nullptr)
@@ -723,11 +1715,11 @@ namespace fsu
             currLayerSize = nextLayerSize;
         } // end while
         if (currLayerSize > 0)
-            std::cerr << "** OAA<K,D,P>::Dump() inconsistency\n";
+            std::cerr << "** OAA<K,D,P,I>::Dump() inconsistency\n";
     } // Dump(os, kw)
     
-    template < typename K , typename D , class P >
-    void OAA<K,D,P>::Dump (std::ostream& os, int kw, char fill) const
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Dump (std::ostream& os, int kw, char fill) const
     {
         // fsu::debug ("Dump(3)");
         if (root_ == nullptr)
@@ -785,6 +1777,136 @@ namespace fsu
         delete fillNode;
     } // Dump(os, kw, fill) */
     
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::DumpBW (std::ostream& os, size_t maxDepth, size_t maxNodes) const
+    {
+        DumpRows(os, 1, 1, '-', maxDepth, maxNodes);
+    } // DumpBW(os, maxDepth, maxNodes)
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::Dump (std::ostream& os, int kw, char fill, size_t maxDepth, size_t maxNodes) const
+    {
+        DumpRows(os, 0, kw, fill, maxDepth, maxNodes);
+    } // Dump(os, kw, fill, maxDepth, maxNodes)
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::DumpRows (std::ostream& os, bool bw, int kw, char fill, size_t maxDepth, size_t maxNodes) const
+    {
+        // Same picture as DumpBW(os) or Dump(os, kw, fill), but a missing child is a
+        // nullptr in the queue and the loop ends at the limits, so only the positions
+        // actually printed are ever queued.
+        if (root_ == nullptr)
+            return;
+        
+        Queue < const Node * , Deque < const Node * > > Que;
+        const Node * current;
+        size_t currLayerSize, nextLayerSize, j, k, depth, shown;
+        Que.Push(root_);
+        currLayerSize = 1;
+        k = 1;  // 2^LayerNumber
+        depth = 0;
+        shown = 0;
+        while (currLayerSize > 0 && depth < maxDepth && k <= maxNodes - shown)
+        {
+            nextLayerSize = 0;
+            if (bw || kw == 1) os << ' '; // indent picture 1 space
+            for (j = 0; j < k; ++j)
+            {
+                current = Que.Front();
+                Que.Pop();
+                if (!bw && kw > 1) os << ' '; // indent each column 1 space
+                if (current == nullptr) // an empty position in the tree
+                {
+                    if (bw) os << fill;
+                    else os << std::setw(kw) << fill;
+                }
+                else if (bw)
+                    os << BWMap(current->flags_);
+                else
+                    os << ColorMap(current->flags_) << std::setw(kw) << current->key_<< ANSI_RESET_ALL;
+                
+                Que.Push(current ? current->lchild_ : nullptr);
+                Que.Push(current ? current->rchild_ : nullptr);
+                if (current && current->lchild_) ++nextLayerSize;
+                if (current && current->rchild_) ++nextLayerSize;
+            }
+            os << '\n';
+            shown += k;
+            currLayerSize = nextLayerSize;
+            k *= 2;
+            ++depth;
+        } // end while
+        if (currLayerSize > 0)
+            os << " ... " << currLayerSize << " nodes on the next level\n";
+        Que.Clear();
+    } // DumpRows()
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::DumpShape (std::ostream& os) const
+    {
+        if (root_ != nullptr)
+            RShape(os, root_);
+        os << '\n';
+    } // DumpShape(os)
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::RShape (std::ostream& os, const Node * n)
+    {
+        os << BWMap(n->flags_);
+        if (n->lchild_ == nullptr && n->rchild_ == nullptr)
+            return;
+        os << '(';
+        if (n->lchild_) RShape(os, n->lchild_); else os << '-';
+        os << ',';
+        if (n->rchild_) RShape(os, n->rchild_); else os << '-';
+        os << ')';
+    }
+    
+    template < typename K , typename D , class P , class I >
+    void OAA<K,D,P,I>::DumpDot (std::ostream& os, size_t maxDepth) const
+    {
+        // red nodes and the links into them are drawn red, dead nodes dashed
+        os << "digraph OAA\n{\n"
+           << "  node [shape=box, style=filled, fontcolor=white];\n";
+        size_t id = 0;
+        if (root_ != nullptr && maxDepth > 0)
+            RDot(os, root_, id, 1, maxDepth);
+        os << "}\n";
+    } // DumpDot(os, maxDepth)
+    
+    template < typename K , typename D , class P , class I >
+    size_t OAA<K,D,P,I>::RDot (std::ostream& os, const Node * n, size_t& id, size_t depth, size_t maxDepth)
+    // writes the node statement for n and its subtree; returns the id given to n
+    {
+        size_t me = id++;
+        std::ostringstream label;
+        label << n->key_;
+        const std::string text = label.str();
+        os << "  n" << me << " [label=\"";
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == '"' || text[i] == '\\') os << '\\'; //escape for a DOT string
+            os << text[i];
+        }
+        os << "\", fillcolor=" << (n->IsRed() ? "red" : "black");
+        if (n->IsDead()) os << ", style=\"filled,dashed\", fontcolor=gray";
+        os << "];\n";
+        if (depth < maxDepth)
+        {
+            if (n->lchild_)
+            {
+                size_t c = RDot(os, n->lchild_, id, depth + 1, maxDepth);
+                os << "  n" << me << " -> n" << c << (n->lchild_->IsRed() ? " [color=red]" : "") << ";\n";
+            }
+            if (n->rchild_)
+            {
+                size_t c = RDot(os, n->rchild_, id, depth + 1, maxDepth);
+                os << "  n" << me << " -> n" << c << (n->rchild_->IsRed() ? " [color=red]" : "") << ";\n";
+            }
+        }
+        return me;
+    }
+    
 } // namespace fsu 
 
 #endif
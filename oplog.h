@@ -0,0 +1,459 @@
+/*
+    oplog.h
+    Andrew J Wood
+
+    Write-ahead operation log with snapshots, for containers that want to
+    survive a crash.
+
+    A log named by base consists of two files. base.snap is a binary snapshot
+    of the container; base.log holds the records appended since that
+    snapshot. Both start with a magic string and a generation number, and the
+    log belongs to the snapshot of the same generation. A snapshot is written
+    to base.snap.tmp and renamed into place, and only then is the log emptied
+    and stamped with the new generation, so a crash at any point leaves either
+    the old snapshot with its log or the new snapshot, whose stale log is
+    recognized by its generation and ignored.
+
+    A record is a 4-byte payload length, the payload, and a 4-byte FNV-1a
+    checksum of the payload. The client builds the payload between Begin()
+    and End(); End() only seals it in memory. Records are written and fsync'ed
+    a group at a time (group commit): when groupBytes are buffered, when a
+    record finds the oldest buffered one groupMillis old, or on Commit(). A
+    crash loses at most the uncommitted group. Open() reads both files into
+    memory for the client to replay, and cuts a torn record off the end of the
+    log before appending after it.
+
+    The snapshot payload is written in chunks from SnapshotBuffer() between
+    BeginSnapshot() and EndSnapshot(); its format is up to the client.
+    Integers in the headers are stored in host byte order. Errors are
+    reported on std::cerr and by a false return.
+*/
+
+#ifndef _OPLOG_H
+#define _OPLOG_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t, uint64_t
+#include <cstdio>     // rename
+#include <cstring>    // memcpy, memcmp, strrchr
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <new>        // std::nothrow
+#include <fcntl.h>    // open
+#include <unistd.h>   // read, write, fsync, ftruncate, close
+#include <sys/stat.h> // fstat
+#include <xstring.h>  // fsu::String
+#include <serial.h>   // ByteBuffer
+
+namespace fsu
+{
+
+  class OpLog
+  {
+  public:
+    OpLog  ();
+    ~OpLog () { Close(); }
+
+    bool   Open  (const char* base, size_t groupBytes, unsigned groupMillis, size_t compactBytes);
+    void   Close (); // commits the group and closes the log
+
+    // recovered contents, from Open() until ReleaseReplay()
+    bool        Recovered    () const { return snapData_ != nullptr || logEnd_ > logBegin_; }
+    const char* SnapshotData (size_t& n) const; // snapshot payload, nullptr if there was none
+    const char* LogBegin     () const { return logBegin_; }
+    const char* LogEnd       () const { return logEnd_; }
+    void        ReleaseReplay ();
+    // steps p over the record it points to; rec, n = its payload
+    static bool NextRecord (const char*& p, const char* end, const char*& rec, size_t& n);
+
+    // appending; once the log file is lost (Active() false), records are dropped
+    ByteBuffer& Begin  (char type); // starts a record with its type byte; append fields to the buffer
+    void        End    ();          // seals the record; commits when the group is full or old
+    bool        Commit ();          // writes the buffered records and fsyncs the log
+    bool        Active () const { return fd_ >= 0; }
+    bool        CompactDue () const { return compactBytes_ > 0 && logBytes_ > compactBytes_; }
+    size_t      LogBytes   () const { return logBytes_; }
+
+    // snapshots: the buffered records are dropped, since the snapshot includes them
+    bool        BeginSnapshot  ();
+    ByteBuffer& SnapshotBuffer () { return snapBuf_; }
+    bool        FlushSnapshot  (); // writes the snapshot buffer out; call when it gets large
+    bool        EndSnapshot    ();
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+    enum { HeaderSize = 16 };
+
+    String      logPath_, snapPath_, tmpPath_;
+    int         fd_, snapFd_;
+    uint64_t    gen_;
+    ByteBuffer  buf_;       // sealed records not yet committed, then the open one
+    size_t      recStart_;  // offset of the open record in buf_
+    size_t      groupBytes_, compactBytes_, logBytes_;
+    unsigned    groupMillis_;
+    Clock::time_point groupStart_; // when the oldest buffered record was sealed
+    ByteBuffer  snapBuf_;
+    uint32_t    snapHash_;
+    char *      snapData_;  // replay data
+    size_t      snapSize_;
+    char *      logData_;
+    const char* logBegin_, * logEnd_;
+
+    static const char* LogMagic  () { return "OAALOG1\n"; }
+    static const char* SnapMagic () { return "OAASNP2\n"; }
+    static uint32_t Fnv (const char* p, size_t n, uint32_t h = 2166136261u)
+    {
+      for (size_t i = 0; i < n; ++i)
+      {
+        h ^= (unsigned char)p[i];
+        h *= 16777619u;
+      }
+      return h;
+    }
+    static bool ReadFile   (const String& path, char*& data, size_t& n); // false on error; data = nullptr if absent
+    static bool WriteAll   (int fd, const char* p, size_t n);
+    static void SyncDir    (const String& path);
+    bool        StartLog   (uint64_t gen);          // empty log stamped gen
+    bool        Fail       (const char* what, const String& path);
+
+    OpLog (const OpLog&);            // not copyable
+    OpLog& operator = (const OpLog&);
+  } ;
+
+  inline OpLog::OpLog ()
+    : fd_(-1), snapFd_(-1), gen_(0), recStart_(0), groupBytes_(0), compactBytes_(0), logBytes_(0),
+      groupMillis_(0), snapHash_(0), snapData_(nullptr), snapSize_(0), logData_(nullptr),
+      logBegin_(nullptr), logEnd_(nullptr)
+  {}
+
+  inline bool OpLog::Fail (const char* what, const String& path)
+  {
+    std::cerr << "** OpLog: " << what << ' ' << path << " (errno " << errno << ")\n";
+    return 0;
+  }
+
+  inline bool OpLog::ReadFile (const String& path, char*& data, size_t& n)
+  {
+    data = nullptr;
+    n = 0;
+    int fd = ::open(path.Cstr(), O_RDONLY);
+    if (fd < 0)
+      return errno == ENOENT;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+      ::close(fd);
+      return 0;
+    }
+    n = (size_t)st.st_size;
+    data = new(std::nothrow) char [n + 1];
+    if (data == nullptr)
+    {
+      std::cerr << "** OpLog memory allocation failure\n";
+      ::close(fd);
+      return 0;
+    }
+    size_t got = 0;
+    while (got < n)
+    {
+      ssize_t r = ::read(fd, data + got, n - got);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        break;
+      got += (size_t)r;
+    }
+    ::close(fd);
+    n = got;
+    return 1;
+  }
+
+  inline bool OpLog::WriteAll (int fd, const char* p, size_t n)
+  {
+    while (n > 0)
+    {
+      ssize_t w = ::write(fd, p, n);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        return 0;
+      p += w;
+      n -= (size_t)w;
+    }
+    return 1;
+  }
+
+  inline void OpLog::SyncDir (const String& path)
+  // makes a rename or file creation in the containing directory durable
+  {
+    const char* p = path.Cstr();
+    const char* slash = strrchr(p, '/');
+    String dir;
+    if (slash == nullptr)
+      dir = ".";
+    else if (slash == p)
+      dir = "/";
+    else
+    {
+      dir.SetSize(slash - p);
+      for (size_t i = 0; i < (size_t)(slash - p); ++i)
+        dir[i] = p[i];
+    }
+    int fd = ::open(dir.Cstr(), O_RDONLY);
+    if (fd >= 0)
+    {
+      fsync(fd);
+      ::close(fd);
+    }
+  }
+
+  inline bool OpLog::Open (const char* base, size_t groupBytes, unsigned groupMillis, size_t compactBytes)
+  {
+    Close();
+    logPath_  = String(base) + String(".log");
+    snapPath_ = String(base) + String(".snap");
+    tmpPath_  = String(base) + String(".snap.tmp");
+    groupBytes_   = groupBytes;
+    groupMillis_  = groupMillis;
+    compactBytes_ = compactBytes;
+
+    // snapshot: magic, generation, payload, then a checksum of everything before it
+    if (!ReadFile(snapPath_, snapData_, snapSize_))
+      return Fail("cannot read", snapPath_);
+    uint64_t snapGen = 0;
+    if (snapData_ != nullptr)
+    {
+      uint32_t sum = 0;
+      bool valid = snapSize_ >= HeaderSize + 4 && memcmp(snapData_, SnapMagic(), 8) == 0;
+      if (valid)
+      {
+        memcpy(&sum, snapData_ + snapSize_ - 4, 4);
+        valid = (sum == Fnv(snapData_, snapSize_ - 4));
+      }
+      if (!valid)
+      {
+        ReleaseReplay();
+        std::cerr << "** OpLog: " << snapPath_ << " is not a valid snapshot\n";
+        return 0;
+      }
+      memcpy(&snapGen, snapData_ + 8, 8);
+    }
+
+    // log: keep the whole records of the snapshot's generation
+    size_t logSize;
+    if (!ReadFile(logPath_, logData_, logSize))
+    {
+      ReleaseReplay();
+      return Fail("cannot read", logPath_);
+    }
+    bool current = logData_ != nullptr && logSize >= HeaderSize && memcmp(logData_, LogMagic(), 8) == 0;
+    if (current)
+    {
+      uint64_t logGen;
+      memcpy(&logGen, logData_ + 8, 8);
+      current = (logGen == snapGen); // else the snapshot already holds these records
+    }
+    if (!current) // missing, torn header, or stale: start over, keeping the snapshot
+    {
+      delete [] logData_;
+      logData_ = nullptr;
+      return StartLog(snapGen);
+    }
+    logBegin_ = logEnd_ = logData_ + HeaderSize;
+    const char* rec;
+    size_t n;
+    for (const char* p = logEnd_; NextRecord(p, logData_ + logSize, rec, n); )
+      logEnd_ = p;
+
+    fd_ = ::open(logPath_.Cstr(), O_WRONLY);
+    if (fd_ < 0)
+    {
+      ReleaseReplay();
+      return Fail("cannot open", logPath_);
+    }
+    logBytes_ = logEnd_ - logData_;
+    if (logBytes_ < logSize && (ftruncate(fd_, logBytes_) != 0 || fsync(fd_) != 0)) // torn tail
+    {
+      ReleaseReplay();
+      Close();
+      return Fail("cannot truncate", logPath_);
+    }
+    lseek(fd_, 0, SEEK_END);
+    gen_ = snapGen;
+    return 1;
+  }
+
+  inline bool OpLog::StartLog (uint64_t gen)
+  {
+    if (fd_ < 0)
+      fd_ = ::open(logPath_.Cstr(), O_WRONLY | O_CREAT, 0644);
+    if (fd_ < 0)
+      return Fail("cannot create", logPath_);
+    char header[HeaderSize];
+    memcpy(header, LogMagic(), 8);
+    memcpy(header + 8, &gen, 8);
+    if (ftruncate(fd_, 0) != 0 || lseek(fd_, 0, SEEK_SET) != 0
+        || !WriteAll(fd_, header, HeaderSize) || fsync(fd_) != 0)
+    {
+      ::close(fd_);
+      fd_ = -1;
+      return Fail("cannot write", logPath_);
+    }
+    SyncDir(logPath_);
+    gen_ = gen;
+    logBytes_ = HeaderSize;
+    buf_.Clear();
+    return 1;
+  }
+
+  inline void OpLog::Close ()
+  {
+    if (fd_ >= 0)
+    {
+      Commit();
+      ::close(fd_);
+      fd_ = -1;
+    }
+    if (snapFd_ >= 0)
+    {
+      ::close(snapFd_);
+      snapFd_ = -1;
+      ::unlink(tmpPath_.Cstr());
+    }
+    buf_.Clear();
+    snapBuf_.Clear();
+    ReleaseReplay();
+  }
+
+  inline const char* OpLog::SnapshotData (size_t& n) const
+  {
+    if (snapData_ == nullptr)
+    {
+      n = 0;
+      return nullptr;
+    }
+    n = snapSize_ - HeaderSize - 4;
+    return snapData_ + HeaderSize;
+  }
+
+  inline void OpLog::ReleaseReplay ()
+  {
+    delete [] snapData_;
+    delete [] logData_;
+    snapData_ = logData_ = nullptr;
+    snapSize_ = 0;
+    logBegin_ = logEnd_ = nullptr;
+  }
+
+  inline bool OpLog::NextRecord (const char*& p, const char* end, const char*& rec, size_t& n)
+  {
+    uint32_t len, sum;
+    if ((size_t)(end - p) < 8)
+      return 0;
+    memcpy(&len, p, 4);
+    if ((size_t)(end - p) - 8 < len)
+      return 0;
+    memcpy(&sum, p + 4 + len, 4);
+    if (len == 0 || sum != Fnv(p + 4, len))
+      return 0;
+    rec = p + 4;
+    n = len;
+    p += 8 + len;
+    return 1;
+  }
+
+  inline ByteBuffer& OpLog::Begin (char type)
+  {
+    recStart_ = buf_.Size();
+    uint32_t len = 0;
+    buf_.Put(&len, 4); // patched by End()
+    buf_.Put(type);
+    return buf_;
+  }
+
+  inline void OpLog::End ()
+  {
+    if (recStart_ + 4 > buf_.Size()) // a failed allocation lost the record
+      return;
+    if (fd_ < 0) // nowhere to write it
+    {
+      buf_.Clear();
+      return;
+    }
+    uint32_t len = (uint32_t)(buf_.Size() - recStart_ - 4);
+    memcpy(buf_.Data() + recStart_, &len, 4);
+    uint32_t sum = Fnv(buf_.Data() + recStart_ + 4, len);
+    buf_.Put(&sum, 4);
+    Clock::time_point now = Clock::now();
+    if (recStart_ == 0)
+      groupStart_ = now;
+    if (buf_.Size() >= groupBytes_
+        || now - groupStart_ >= std::chrono::milliseconds(groupMillis_))
+      Commit();
+  }
+
+  inline bool OpLog::Commit ()
+  {
+    if (fd_ < 0)
+    {
+      buf_.Clear();
+      return 0;
+    }
+    if (buf_.Size() == 0)
+      return 1;
+    bool ok = WriteAll(fd_, buf_.Data(), buf_.Size()) && fsync(fd_) == 0;
+    if (ok)
+      logBytes_ += buf_.Size();
+    buf_.Clear();
+    if (!ok)
+      return Fail("cannot write", logPath_);
+    return 1;
+  }
+
+  inline bool OpLog::BeginSnapshot ()
+  {
+    if (fd_ < 0)
+      return 0;
+    if (snapFd_ >= 0)
+      ::close(snapFd_);
+    snapFd_ = ::open(tmpPath_.Cstr(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (snapFd_ < 0)
+      return Fail("cannot create", tmpPath_);
+    uint64_t gen = gen_ + 1;
+    snapBuf_.Clear();
+    snapBuf_.Put(SnapMagic(), 8);
+    snapBuf_.Put(&gen, 8);
+    snapHash_ = 2166136261u;
+    return 1;
+  }
+
+  inline bool OpLog::FlushSnapshot ()
+  {
+    if (snapFd_ < 0)
+      return 0;
+    snapHash_ = Fnv(snapBuf_.Data(), snapBuf_.Size(), snapHash_);
+    bool ok = WriteAll(snapFd_, snapBuf_.Data(), snapBuf_.Size());
+    snapBuf_.Clear();
+    if (!ok)
+      return Fail("cannot write", tmpPath_);
+    return 1;
+  }
+
+  inline bool OpLog::EndSnapshot ()
+  {
+    if (!FlushSnapshot())
+      return 0;
+    if (!WriteAll(snapFd_, (const char*)&snapHash_, 4) || fsync(snapFd_) != 0)
+      return Fail("cannot write", tmpPath_);
+    ::close(snapFd_);
+    snapFd_ = -1;
+    if (rename(tmpPath_.Cstr(), snapPath_.Cstr()) != 0)
+      return Fail("cannot rename", tmpPath_);
+    SyncDir(snapPath_);
+    return StartLog(gen_ + 1); // the old log is stale from here on
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,312 @@
+/*
+    postings.h
+    Andrew J Wood
+
+    Postings: an inverted index from each word to where it occurs.
+
+    An occurrence is a (file, position) pair: file is a number the caller
+    gives with Start(), in increasing order, and position counts the words
+    added since that Start() from 0. Each word's occurrences are kept in the
+    order they were added, delta encoded as LEB128 varints (serial.h): an
+    occurrence in the same file as the word's last one is the varint of
+    twice the position gap; the first in a later file is the varint of twice
+    the file gap plus 1, then the position itself. A frequent word costs one
+    byte or two per occurrence.
+
+    Each word (numbered by WordIds, wordids.h) has a chain of blocks that
+    double in size from 16 to 4096 bytes, cut from 1 MB slabs, so that adding
+    an occurrence writes a few bytes in place and allocates nothing; only a
+    new block, a new slab or a new word's list header ever allocates. An
+    occurrence is never split across blocks, so a Cursor decodes each block
+    in one pass.
+
+    Find() gives a Cursor over a word's occurrences in order, in O(1) time
+    plus the cost of the walk. Intersect() merges two words' cursors by file
+    and calls f(file, count of the first, count of the second) for each file
+    that holds both.
+*/
+
+#ifndef _POSTINGS_H
+#define _POSTINGS_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+#include <xstring.h>  // fsu::String
+#include <wordids.h>  // WordIds
+#include <serial.h>   // GetVarint
+
+namespace fsu
+{
+
+  class Postings
+  {
+  private:
+    struct Block
+    {
+      Block *  next;
+      uint32_t size;  // data bytes, which follow the Block
+      uint32_t used;
+      char *   Data () { return reinterpret_cast<char*>(this + 1); }
+      const char * Data () const { return reinterpret_cast<const char*>(this + 1); }
+    };
+
+  public:
+    class Cursor
+    {
+    public:
+      Cursor () : block_(nullptr), p_(nullptr), file_(0), pos_(0) {}
+      bool Next (uint32_t& file, unsigned long long& pos); // the next occurrence; false at the end
+    private:
+      friend class Postings;
+      const Block * block_;
+      const char *  p_;
+      uint32_t      file_;
+      unsigned long long pos_;
+    } ;
+
+    Postings  () : ids_(), list_(nullptr), cap_(0), slab_(nullptr), free_(nullptr), room_(0),
+                   file_(0), position_(0), total_(0), bytes_(0) {}
+    ~Postings () { Clear(); }
+
+    void   Start (uint32_t file) { file_ = file; position_ = 0; } // the next words begin file
+    void   Add   (const String& word);                           // at the next position of the file
+    void   Clear ();
+
+    bool   Find  (const String& word, Cursor& c, size_t& count) const; // false if word never occurred
+    template < class F >
+    size_t Intersect (const String& a, const String& b, F f) const;   // returns the number of files with both
+
+    size_t Words () const { return ids_.Size(); }                    // distinct words indexed
+    unsigned long long Total () const { return total_; }             // occurrences
+    size_t Bytes () const { return bytes_; }                         // memory of lists, blocks and slabs
+
+  private:
+    struct List
+    {
+      Block *  head, * tail;
+      uint32_t lastFile;
+      unsigned long long lastPos;
+      size_t   count;
+    };
+
+    static const size_t FirstBlock = 16, LastBlock = 4096, SlabSize = 1 << 20;
+
+    WordIds  ids_;
+    List *   list_;      // list_[word ID]
+    size_t   cap_;
+    char *   slab_;      // the newest slab; its first bytes point to the one before
+    char *   free_;      // unused part of it
+    size_t   room_;
+    uint32_t file_;
+    unsigned long long position_, total_;
+    size_t   bytes_;
+
+    Block * NewBlock (size_t size);  // nullptr if out of memory
+    bool    Grow     ();             // room for one more list
+
+    static size_t PutVarint (char* p, unsigned long long x)
+    {
+      size_t n = 0;
+      for (; x >= 0x80; x >>= 7)
+        p[n++] = (char)((x & 0x7F) | 0x80);
+      p[n++] = (char)x;
+      return n;
+    }
+
+    Postings (const Postings&);            // not copyable
+    Postings& operator = (const Postings&);
+  } ;
+
+  inline Postings::Block * Postings::NewBlock (size_t size)
+  {
+    size_t need = sizeof(Block) + size; // a multiple of sizeof(Block): blocks stay aligned
+    if (need > room_)
+    {
+      char * slab = new(std::nothrow) char [SlabSize];
+      if (slab == nullptr)
+      {
+        std::cerr << "** Postings memory allocation failure\n";
+        return nullptr;
+      }
+      *reinterpret_cast<char**>(slab) = slab_;
+      slab_ = slab;
+      free_ = slab + sizeof(Block); // keeps the link and alignment
+      room_ = SlabSize - sizeof(Block);
+      bytes_ += SlabSize;
+    }
+    Block * b = reinterpret_cast<Block*>(free_);
+    free_ += need;
+    room_ -= need;
+    b->next = nullptr;
+    b->size = (uint32_t)size;
+    b->used = 0;
+    return b;
+  }
+
+  inline bool Postings::Grow ()
+  {
+    size_t cap = cap_ ? 2 * cap_ : 1024;
+    List * bigger = new(std::nothrow) List [cap];
+    if (bigger == nullptr)
+    {
+      std::cerr << "** Postings memory allocation failure\n";
+      return 0;
+    }
+    for (size_t i = 0; i < cap_; ++i)
+      bigger[i] = list_[i];
+    for (size_t i = cap_; i < cap; ++i)
+    {
+      bigger[i].head = bigger[i].tail = nullptr;
+      bigger[i].lastFile = 0;
+      bigger[i].lastPos = 0;
+      bigger[i].count = 0;
+    }
+    delete [] list_;
+    bytes_ += (cap - cap_) * sizeof(List);
+    list_ = bigger;
+    cap_ = cap;
+    return 1;
+  }
+
+  inline void Postings::Add (const String& word)
+  {
+    unsigned long long pos = position_++;
+    size_t n = ids_.Size();
+    uint32_t id = ids_.Id(word);
+    if (id == WordIds::NoId)
+      return;
+    if (id == n) // a new word: its list starts with this occurrence
+    {
+      Block * b = (id < cap_ || Grow()) ? NewBlock(FirstBlock) : nullptr;
+      if (b == nullptr)
+        return; // the word has an ID but no list; Find() checks count
+      list_[id].head = list_[id].tail = b;
+    }
+    if (id >= cap_ || list_[id].head == nullptr) // its first occurrence could not be stored
+      return;
+
+    List& l = list_[id];
+    char code[20];
+    size_t len;
+    if (l.count > 0 && file_ == l.lastFile)
+      len = PutVarint(code, (pos - l.lastPos) << 1);
+    else
+    {
+      len = PutVarint(code, ((unsigned long long)(file_ - l.lastFile) << 1) | 1); // from file 0 at first
+      len += PutVarint(code + len, pos);
+    }
+    Block * b = l.tail;
+    if (b->size - b->used < len)
+    {
+      size_t size = 2 * b->size;
+      if (size > LastBlock) size = LastBlock;
+      b = NewBlock(size);
+      if (b == nullptr)
+        return;
+      l.tail->next = b;
+      l.tail = b;
+    }
+    char * p = b->Data() + b->used;
+    for (size_t i = 0; i < len; ++i)
+      p[i] = code[i];
+    b->used += (uint32_t)len;
+    l.lastFile = file_;
+    l.lastPos = pos;
+    ++l.count;
+    ++total_;
+  }
+
+  inline void Postings::Clear ()
+  {
+    while (slab_ != nullptr)
+    {
+      char * before = *reinterpret_cast<char**>(slab_);
+      delete [] slab_;
+      slab_ = before;
+    }
+    delete [] list_;
+    list_ = nullptr;
+    cap_ = room_ = 0;
+    free_ = nullptr;
+    ids_.Clear();
+    file_ = 0;
+    position_ = total_ = 0;
+    bytes_ = 0;
+  }
+
+  inline bool Postings::Find (const String& word, Cursor& c, size_t& count) const
+  {
+    uint32_t id = ids_.Find(word);
+    if (id == WordIds::NoId || id >= cap_ || list_[id].count == 0)
+    {
+      count = 0;
+      return 0;
+    }
+    c.block_ = list_[id].head;
+    c.p_ = c.block_->Data();
+    c.file_ = 0; // the first occurrence's file gap is taken from 0
+    c.pos_ = 0;
+    count = list_[id].count;
+    return 1;
+  }
+
+  inline bool Postings::Cursor::Next (uint32_t& file, unsigned long long& pos)
+  {
+    while (block_ != nullptr && p_ == block_->Data() + block_->used)
+    {
+      block_ = block_->next;
+      p_ = (block_ != nullptr) ? block_->Data() : nullptr;
+    }
+    if (block_ == nullptr)
+      return 0;
+    const char * end = block_->Data() + block_->used;
+    unsigned long long code, x;
+    GetVarint(p_, end, code);
+    if (code & 1) // a later file, then the position
+    {
+      file_ += (uint32_t)(code >> 1);
+      GetVarint(p_, end, x);
+      pos_ = x;
+    }
+    else
+      pos_ += code >> 1;
+    file = file_;
+    pos = pos_;
+    return 1;
+  }
+
+  template < class F >
+  size_t Postings::Intersect (const String& a, const String& b, F f) const
+  {
+    Cursor ca, cb;
+    size_t na, nb;
+    if (!Find(a, ca, na) || !Find(b, cb, nb))
+      return 0;
+    uint32_t fa, fb;
+    unsigned long long pa, pb;
+    bool moreA = ca.Next(fa, pa), moreB = cb.Next(fb, pb);
+    size_t files = 0;
+    while (moreA && moreB)
+    {
+      if (fa < fb)
+        moreA = ca.Next(fa, pa);
+      else if (fb < fa)
+        moreB = cb.Next(fb, pb);
+      else // count both words' occurrences in this file
+      {
+        uint32_t file = fa;
+        size_t countA = 0, countB = 0;
+        for (; moreA && fa == file; moreA = ca.Next(fa, pa)) ++countA;
+        for (; moreB && fb == file; moreB = cb.Next(fb, pb)) ++countB;
+        f(file, countA, countB);
+        ++files;
+      }
+    }
+    return files;
+  }
+
+} // namespace fsu
+
+#endif
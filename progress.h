@@ -0,0 +1,103 @@
+/*
+    progress.h
+    Andrew J Wood
+
+    Time-based progress reports for a long read.
+
+    A reader counts tokens down in ticks and calls Check() when it reaches 0,
+    so that the only cost per token is that counter; Check() sets ticks again
+    and reads the clock, and at most once per interval writes one line: how
+    far the read has got (and what percent of the input, when its size is
+    known), bytes and words per second since the read began, the time left
+    at that rate, the vocabulary size and the memory of the word table.
+
+    The counts a reader passes to Check() are those of the range it is
+    scanning; the public members hold what came before that range, and the
+    reader adds each finished range to them with Add(). The vocabulary is
+    vocabBefore plus the new words of the range, and the table memory is the
+    vocabulary times entryBytes, plus fixedBytes.
+*/
+
+#ifndef _PROGRESS_H
+#define _PROGRESS_H
+
+#include <cstddef>    // size_t
+#include <chrono>     // std::chrono::steady_clock
+#include <iostream>
+#include <iomanip>
+
+namespace fsu
+{
+
+  class ReadProgress
+  {
+  public:
+    static const size_t Every = 16384;   // tokens between looks at the clock
+
+    ReadProgress (std::ostream& os, size_t totalBytes, double interval = 1.0); // totalBytes 0 = unknown
+
+    size_t ticks;        // tokens until the next Check()
+    size_t bytesBefore;  // input before the range being scanned
+    size_t wordsBefore;  // words counted before it
+    size_t vocabBefore;  // vocabulary size before it
+    size_t entryBytes;   // table memory per word
+    size_t fixedBytes;   // table memory that does not grow
+
+    void Check (size_t bytes, size_t words, size_t newWords); // counts within the range
+    void Add   (size_t bytes, size_t words, size_t newWords)  // the range is done
+    {
+      bytesBefore += bytes;
+      wordsBefore += words;
+      vocabBefore += newWords;
+    }
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::ostream&     os_;
+    size_t            total_;
+    Clock::duration   interval_;
+    Clock::time_point start_, next_;
+
+    ReadProgress (const ReadProgress&);            // not copyable
+    ReadProgress& operator = (const ReadProgress&);
+  } ;
+
+  inline ReadProgress::ReadProgress (std::ostream& os, size_t totalBytes, double interval)
+    : ticks(Every), bytesBefore(0), wordsBefore(0), vocabBefore(0), entryBytes(0), fixedBytes(0),
+      os_(os), total_(totalBytes),
+      interval_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval))),
+      start_(Clock::now()), next_(start_ + interval_)
+  {}
+
+  inline void ReadProgress::Check (size_t bytes, size_t words, size_t newWords)
+  {
+    ticks = Every;
+    Clock::time_point now = Clock::now();
+    if (now < next_)
+      return;
+    next_ = now + interval_;
+
+    const double MB = 1 << 20;
+    double seconds = std::chrono::duration<double>(now - start_).count();
+    size_t done = bytesBefore + bytes, numWords = wordsBefore + words, vocab = vocabBefore + newWords;
+    double byteRate = done / seconds;
+
+    std::ios_base::fmtflags flags = os_.flags();
+    std::streamsize precision = os_.precision(1);
+    os_.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    os_ << "  ** reading progress : " << done / MB << " MB";
+    if (total_ > 0)
+      os_ << " of " << total_ / MB << " MB (" << (100.0 * done / total_) << "%)";
+    os_ << ", " << byteRate / MB << " MB/s, " << numWords / seconds / 1e6 << "M words/s";
+    if (total_ > done && byteRate > 0)
+      os_ << ", ETA " << (size_t)((total_ - done) / byteRate + 0.5) << " s";
+    os_ << ", numwords == " << numWords << ", vocabulary == " << vocab
+        << ", table " << (vocab * entryBytes + fixedBytes) / MB << " MB\n";
+    os_.flags(flags);
+    os_.precision(precision);
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,400 @@
+/*
+    runs.h
+    Andrew J Wood
+
+    Sorted runs of (word, count) pairs in temporary files, for counting more
+    distinct words than fit in memory.
+
+    RunWriter writes one run to a new file made by mkstemp() in $TMPDIR, or
+    /tmp. Words must come in increasing order, each once; a word is front-coded
+    against the one before as the WordSmith state file does: varints (serial.h)
+    for the length of the shared prefix and of the rest, the rest's bytes, and
+    a varint count. Output goes through a 1 MB buffer. Close() reports whether
+    every byte reached the file, and removes the file if not.
+
+    RunReader reads a run back in order through a buffer of its own, which
+    grows only for a word longer than it. RunMerger reads any number of runs at
+    once: a binary heap of run numbers, ordered by each run's current word,
+    yields every word once, in increasing order, with its counts in all runs
+    summed. It holds a descriptor, a buffer and a word per run, however large
+    the runs are, so a caller keeps the number of runs it merges at once within
+    FanIn(): at most 64, and at most half the descriptors the process may open.
+*/
+
+#ifndef _RUNS_H
+#define _RUNS_H
+
+#include <cstddef>    // size_t
+#include <cstdlib>    // getenv, mkstemp
+#include <cstdio>     // remove
+#include <cerrno>     // errno, EINTR
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+#include <fcntl.h>    // open
+#include <unistd.h>   // read, write, close
+#include <sys/resource.h> // getrlimit
+#include <xstring.h>  // fsu::String
+#include <list.h>     // fsu::List
+#include <serial.h>   // ByteBuffer, GetVarint
+
+namespace fsu
+{
+
+  class RunWriter
+  {
+  public:
+    RunWriter  () : fd_(-1), ok_(0), buf_(), prev_(), path_(), words_(0) {}
+    ~RunWriter () { if (fd_ >= 0) { ::close(fd_); std::remove(path_.Cstr()); } }
+
+    bool   Open  ();                    // a new, empty run; false if no file could be made
+    void   Put   (const String& word, unsigned long long count); // words in increasing order
+    bool   Close ();                    // false if the run could not be written whole; it is then removed
+
+    const String& Path  () const { return path_; }
+    size_t        Words () const { return words_; }
+
+  private:
+    static const size_t BufSize = 1 << 20;
+
+    int        fd_;
+    bool       ok_;
+    ByteBuffer buf_;
+    ByteBuffer prev_;   // the word before
+    String     path_;
+    size_t     words_;
+
+    bool Flush ();
+
+    RunWriter (const RunWriter&);            // not copyable
+    RunWriter& operator = (const RunWriter&);
+  } ;
+
+  inline bool RunWriter::Open ()
+  {
+    const char * dir = std::getenv("TMPDIR");
+    if (dir == nullptr || *dir == '\0')
+      dir = "/tmp";
+    String name = String(dir) + String("/wsrunXXXXXX");
+    char * templ = new(std::nothrow) char [name.Size() + 1];
+    if (templ == nullptr)
+    {
+      std::cerr << "** RunWriter memory allocation failure\n";
+      return 0;
+    }
+    for (size_t i = 0; i <= name.Size(); ++i)
+      templ[i] = name.Cstr()[i];
+    fd_ = mkstemp(templ);
+    path_ = String(templ);
+    delete [] templ;
+    if (fd_ < 0)
+    {
+      std::cerr << "** RunWriter cannot make a file in " << dir << "\n";
+      return 0;
+    }
+    ok_ = buf_.Reserve(BufSize);
+    buf_.Clear();
+    prev_.Clear();
+    words_ = 0;
+    return 1;
+  }
+
+  inline void RunWriter::Put (const String& word, unsigned long long count)
+  {
+    if (!ok_)
+      return;
+    const char * w = word.Cstr();
+    size_t n = word.Size(), m = prev_.Size(), shared = 0;
+    while (shared < n && shared < m && w[shared] == prev_.Data()[shared]) ++shared;
+    ok_ = buf_.PutVarint(shared) && buf_.PutVarint(n - shared) && buf_.Put(w + shared, n - shared)
+          && buf_.PutVarint(count);
+    prev_.Shrink(shared);
+    ok_ = ok_ && prev_.Put(w + shared, n - shared);
+    ++words_;
+    if (ok_ && buf_.Size() >= BufSize)
+      ok_ = Flush();
+  }
+
+  inline bool RunWriter::Flush ()
+  {
+    const char * p = buf_.Data();
+    size_t n = buf_.Size();
+    while (n > 0)
+    {
+      ssize_t w = ::write(fd_, p, n);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        return 0;
+      p += w;
+      n -= (size_t)w;
+    }
+    buf_.Clear();
+    return 1;
+  }
+
+  inline bool RunWriter::Close ()
+  {
+    if (fd_ < 0)
+      return 0;
+    bool ok = ok_ && Flush();
+    ok = (::close(fd_) == 0) && ok;
+    fd_ = -1;
+    if (!ok)
+    {
+      std::remove(path_.Cstr());
+      std::cerr << "** RunWriter cannot write " << path_ << "\n";
+    }
+    return ok;
+  }
+
+  class RunReader
+  {
+  public:
+    RunReader  () : fd_(-1), data_(nullptr), cap_(0), pos_(0), len_(0), eof_(0), error_(0), word_() {}
+    ~RunReader () { Close(); delete [] data_; }
+
+    bool Open  (const String& path, size_t bufSize = 1 << 20);
+    void Close () { if (fd_ >= 0) ::close(fd_); fd_ = -1; }
+    bool Next  (String& word, unsigned long long& count); // false at the end of the run, or on an error
+    bool Error () const { return error_; }                 // the run could not be read, or is damaged
+
+  private:
+    int        fd_;
+    char *     data_;
+    size_t     cap_, pos_, len_;  // data_[pos_, len_) is not yet decoded
+    bool       eof_, error_;
+    ByteBuffer word_;             // the word before, then this one
+
+    bool Refill ();  // moves what is left to the front and reads more; grows the buffer if it is full
+
+    RunReader (const RunReader&);            // not copyable
+    RunReader& operator = (const RunReader&);
+  } ;
+
+  inline bool RunReader::Open (const String& path, size_t bufSize)
+  {
+    Close();
+    delete [] data_;
+    data_ = new(std::nothrow) char [bufSize];
+    cap_ = (data_ != nullptr) ? bufSize : 0;
+    pos_ = len_ = 0;
+    eof_ = error_ = 0;
+    word_.Clear();
+    if (data_ == nullptr)
+    {
+      std::cerr << "** RunReader memory allocation failure\n";
+      error_ = 1;
+      return 0;
+    }
+    fd_ = ::open(path.Cstr(), O_RDONLY);
+    if (fd_ < 0)
+    {
+      std::cerr << "** RunReader cannot open " << path << "\n";
+      error_ = 1;
+      return 0;
+    }
+    return 1;
+  }
+
+  inline bool RunReader::Refill ()
+  {
+    size_t left = len_ - pos_;
+    if (left == cap_) // one record fills the buffer: make room for the rest of it
+    {
+      char * bigger = new(std::nothrow) char [2 * cap_];
+      if (bigger == nullptr)
+      {
+        std::cerr << "** RunReader memory allocation failure\n";
+        return 0;
+      }
+      for (size_t i = 0; i < left; ++i)
+        bigger[i] = data_[pos_ + i];
+      delete [] data_;
+      data_ = bigger;
+      cap_ *= 2;
+    }
+    else
+    {
+      for (size_t i = 0; i < left; ++i)
+        data_[i] = data_[pos_ + i];
+    }
+    pos_ = 0;
+    len_ = left;
+    for (;;)
+    {
+      ssize_t r = ::read(fd_, data_ + len_, cap_ - len_);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r < 0)
+        return 0;
+      if (r == 0)
+        eof_ = 1;
+      len_ += (size_t)r;
+      return 1;
+    }
+  }
+
+  inline bool RunReader::Next (String& word, unsigned long long& count)
+  {
+    while (fd_ >= 0 && !error_)
+    {
+      const char * p = data_ + pos_, * end = data_ + len_;
+      unsigned long long shared, rest, c;
+      if (fsu::GetVarint(p, end, shared) && fsu::GetVarint(p, end, rest) && rest <= (unsigned long long)(end - p))
+      {
+        const char * bytes = p;
+        p += rest;
+        if (fsu::GetVarint(p, end, c))
+        {
+          if (shared > word_.Size() || shared + rest == 0)
+            break;
+          word_.Shrink((size_t)shared);
+          if (!word_.Put(bytes, (size_t)rest))
+            break;
+          pos_ = p - data_;
+          size_t n = word_.Size();
+          if (word.Size() != n && !word.SetSize(n))
+            break;
+          for (size_t i = 0; i < n; ++i)
+            word[i] = word_.Data()[i];
+          count = c;
+          return 1;
+        }
+      }
+      if (eof_) // the end, or a record cut short
+      {
+        error_ = pos_ < len_;
+        return 0;
+      }
+      if (!Refill())
+        break;
+    }
+    error_ = 1;
+    return 0;
+  }
+
+  class RunMerger
+  {
+  public:
+    RunMerger  () : run_(nullptr), word_(nullptr), count_(nullptr), heap_(nullptr), runs_(0), size_(0), error_(0) {}
+    ~RunMerger () { Release(); }
+
+    bool Open  (const List<String>& paths, size_t bufSize = 1 << 18); // false if a run could not be opened
+    bool Next  (String& word, unsigned long long& count); // false when every run is done
+    bool Error () const { return error_; }  // a run could not be read whole
+
+    static size_t FanIn (size_t most = 64)  // runs to merge at once, at least 2
+    {
+      struct rlimit rl;
+      if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur / 2 < most)
+        most = (size_t)rl.rlim_cur / 2;
+      return most > 2 ? most : 2;
+    }
+
+  private:
+    RunReader *          run_;
+    String *             word_;   // word_[r], count_[r]: run r's current pair
+    unsigned long long * count_;
+    size_t *             heap_;   // run numbers, smallest current word first
+    size_t               runs_, size_;
+    bool                 error_;
+
+    bool Below (size_t i, size_t j) const { return word_[heap_[i]] < word_[heap_[j]]; } // heap positions
+    void SiftDown (size_t i);
+    void Advance  (size_t r);     // run r's next pair in place of the one at the root
+    void Release  ();
+
+    RunMerger (const RunMerger&);            // not copyable
+    RunMerger& operator = (const RunMerger&);
+  } ;
+
+  inline void RunMerger::Release ()
+  {
+    delete [] run_;
+    delete [] word_;
+    delete [] count_;
+    delete [] heap_;
+    run_ = nullptr;
+    word_ = nullptr;
+    count_ = nullptr;
+    heap_ = nullptr;
+    runs_ = size_ = 0;
+  }
+
+  inline void RunMerger::SiftDown (size_t i)
+  {
+    for (;;)
+    {
+      size_t least = i, l = 2 * i + 1, r = l + 1;
+      if (l < size_ && Below(l, least)) least = l;
+      if (r < size_ && Below(r, least)) least = r;
+      if (least == i)
+        return;
+      size_t t = heap_[i]; heap_[i] = heap_[least]; heap_[least] = t;
+      i = least;
+    }
+  }
+
+  inline void RunMerger::Advance (size_t r)
+  {
+    if (!run_[r].Next(word_[r], count_[r]))
+    {
+      error_ = error_ || run_[r].Error();
+      run_[r].Close();
+      heap_[0] = heap_[--size_];
+    }
+    SiftDown(0);
+  }
+
+  inline bool RunMerger::Open (const List<String>& paths, size_t bufSize)
+  {
+    Release();
+    error_ = 0;
+    size_t n = paths.Size();
+    run_ = new(std::nothrow) RunReader [n > 0 ? n : 1];
+    word_ = new(std::nothrow) String [n > 0 ? n : 1];
+    count_ = new(std::nothrow) unsigned long long [n > 0 ? n : 1];
+    heap_ = new(std::nothrow) size_t [n > 0 ? n : 1];
+    if (run_ == nullptr || word_ == nullptr || count_ == nullptr || heap_ == nullptr)
+    {
+      std::cerr << "** RunMerger memory allocation failure\n";
+      Release();
+      return 0;
+    }
+    runs_ = n;
+    size_t r = 0;
+    for (List<String>::ConstIterator i = paths.Begin(); i != paths.End(); ++i, ++r)
+    {
+      if (!run_[r].Open(*i, bufSize))
+      {
+        Release();
+        error_ = 1;
+        return 0;
+      }
+      if (run_[r].Next(word_[r], count_[r]))
+        heap_[size_++] = r;
+      else if (run_[r].Error())
+        error_ = 1;
+    }
+    for (size_t i = size_ / 2; i-- > 0; )
+      SiftDown(i);
+    return 1;
+  }
+
+  inline bool RunMerger::Next (String& word, unsigned long long& count)
+  {
+    if (size_ == 0)
+      return 0;
+    word = word_[heap_[0]];
+    count = 0;
+    while (size_ > 0 && word_[heap_[0]] == word) // a word is in each run at most once
+    {
+      count += count_[heap_[0]];
+      Advance(heap_[0]);
+    }
+    return 1;
+  }
+
+} // namespace fsu
+
+#endif
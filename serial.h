@@ -0,0 +1,163 @@
+/*
+    serial.h
+    Andrew J Wood
+
+    Binary encoding of keys and data for files written by fsu containers.
+
+    ByteBuffer is a growable byte array with the append operations the
+    encoders need. Varints are LEB128: 7 bits per byte, low bits first, high
+    bit set on every byte but the last.
+
+    Serial<T> writes a T to a ByteBuffer and reads it back from a byte range.
+    The primary template copies the object representation, so it is limited to
+    trivially copyable types and to files read back on the same platform;
+    fsu::String is written as a varint length followed by its characters.
+    Read() advances p and returns false, leaving p unspecified, when the range
+    ends before a whole value.
+*/
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include <cstddef>      // size_t
+#include <cstring>      // memcpy, strlen
+#include <iostream>     // std::cerr
+#include <new>          // std::nothrow
+#include <type_traits>  // std::is_trivially_copyable
+#include <xstring.h>    // fsu::String
+
+namespace fsu
+{
+
+  class ByteBuffer
+  {
+  public:
+    ByteBuffer  () : data_(nullptr), size_(0), cap_(0) {}
+    ~ByteBuffer () { delete [] data_; }
+
+    bool   Put       (const void* p, size_t n);
+    bool   Put       (char c) { return Put(&c, 1); }
+    bool   PutVarint (unsigned long long x);
+    bool   Reserve   (size_t n); // room for n bytes in all
+
+    char*       Data ()       { return data_; }
+    const char* Data () const { return data_; }
+    size_t      Size () const { return size_; }
+    void        Clear ()      { size_ = 0; }
+    void        Shrink (size_t n) { if (n < size_) size_ = n; } // keeps the first n bytes
+
+  private:
+    char *  data_;
+    size_t  size_, cap_;
+
+    ByteBuffer (const ByteBuffer&);            // not copyable
+    ByteBuffer& operator = (const ByteBuffer&);
+  } ;
+
+  inline bool ByteBuffer::Reserve (size_t n)
+  {
+    if (n <= cap_)
+      return 1;
+    size_t newcap = cap_ ? cap_ : 256;
+    while (newcap < n) newcap *= 2;
+    char * bigger = new(std::nothrow) char [newcap];
+    if (bigger == nullptr)
+    {
+      std::cerr << "** ByteBuffer memory allocation failure\n";
+      return 0;
+    }
+    if (size_ > 0)
+      memcpy(bigger, data_, size_);
+    delete [] data_;
+    data_ = bigger;
+    cap_ = newcap;
+    return 1;
+  }
+
+  inline bool ByteBuffer::Put (const void* p, size_t n)
+  {
+    if (size_ + n > cap_ && !Reserve(size_ + n))
+      return 0;
+    if (n > 0)
+      memcpy(data_ + size_, p, n);
+    size_ += n;
+    return 1;
+  }
+
+  inline bool ByteBuffer::PutVarint (unsigned long long x)
+  {
+    char b[10];
+    size_t n = 0;
+    while (x >= 0x80)
+    {
+      b[n++] = (char)(x | 0x80);
+      x >>= 7;
+    }
+    b[n++] = (char)x;
+    return Put(b, n);
+  }
+
+  inline bool GetVarint (const char*& p, const char* end, unsigned long long& x)
+  {
+    x = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+      unsigned char b = (unsigned char)*p++;
+      x |= (unsigned long long)(b & 0x7F) << shift;
+      if ((b & 0x80) == 0)
+        return 1;
+    }
+    return 0;
+  }
+
+  template < typename T >
+  class Serial
+  {
+  public:
+    static bool Write (ByteBuffer& out, const T& t)
+    {
+      static_assert(std::is_trivially_copyable<T>::value, "Serial<T> needs a specialization for this type");
+      return out.Put(&t, sizeof(T));
+    }
+    static bool Read (const char*& p, const char* end, T& t)
+    {
+      if ((size_t)(end - p) < sizeof(T))
+        return 0;
+      memcpy(&t, p, sizeof(T));
+      p += sizeof(T);
+      return 1;
+    }
+  } ;
+
+  template <>
+  class Serial < String >
+  {
+  public:
+    static bool Write (ByteBuffer& out, const String& s)
+    {
+      const char* c = s.Cstr();
+      size_t n = (c != nullptr) ? strlen(c) : 0;
+      return out.PutVarint(n) && out.Put(c, n);
+    }
+    static bool Read (const char*& p, const char* end, String& s)
+    {
+      unsigned long long n;
+      if (!GetVarint(p, end, n) || n > (unsigned long long)(end - p))
+        return 0;
+      if (n == 0)
+      {
+        s.Clear(); // the empty String has no data, as String() does
+        return 1;
+      }
+      if (!s.SetSize((size_t)n))
+        return 0;
+      for (size_t i = 0; i < n; ++i)
+        s[i] = p[i];
+      p += n;
+      return 1;
+    }
+  } ;
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,209 @@
+/*
+    sketch.h
+    Andrew J Wood
+
+    Fixed-memory summaries of a stream of keys, given as 64-bit hashes.
+
+    CountMin estimates how often each key has been added. It keeps depth
+    rows of width counters (width a power of 2); a key maps to one counter
+    per row, and its estimate is the smallest of them. Add() uses the
+    conservative update, raising only the counters below the new estimate,
+    so an estimate never falls below the true count, only grows as keys are
+    added, and exceeds the true count by at most e * Total() / width with
+    probability at least 1 - exp(-depth).
+
+    HyperLogLog estimates how many distinct keys have been added, from 2^p
+    one-byte registers holding the longest run of leading zero bits seen in
+    the hashes that select them; its relative standard error is
+    1.04 / sqrt(2^p). Small counts are estimated by linear counting.
+
+    The row counters of CountMin are taken from one hash by double hashing
+    (Kirsch and Mitzenmacher), so both summaries want well-mixed hashes: use
+    Mix() on a hash whose low or high bits are weak.
+*/
+
+#ifndef _SKETCH_H
+#define _SKETCH_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint8_t, uint32_t
+#include <cmath>      // exp, log, sqrt
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+
+namespace fsu
+{
+
+  inline unsigned long long Mix (unsigned long long x) // murmur3 finalizer
+  {
+    x ^= x >> 33; x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33; x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+  }
+
+  class CountMin
+  {
+  public:
+    CountMin  () : count_(nullptr), width_(0), depth_(0), total_(0) {}
+    ~CountMin () { delete [] count_; }
+
+    bool   Reset    (size_t budget, size_t depth = 5); // widest rows within budget bytes
+    void   Clear    ();                                 // zero counts, same size
+    unsigned long long Add      (unsigned long long h, unsigned long long n = 1); // returns the new estimate
+    unsigned long long Estimate (unsigned long long h) const;
+
+    size_t Width    () const { return width_; }
+    size_t Depth    () const { return depth_; }
+    size_t Memory   () const { return width_ * depth_ * sizeof(unsigned long long); }
+    unsigned long long Total () const { return total_; }
+    unsigned long long Error () const // e * Total() / width, rounded up
+    {
+      return width_ ? (unsigned long long)std::ceil(std::exp(1.0) * (double)total_ / (double)width_) : 0;
+    }
+    double Confidence () const { return 1.0 - std::exp(-(double)depth_); }
+
+  private:
+    unsigned long long * count_;  // row r is count_[r * width_ ...]
+    size_t               width_, depth_;
+    unsigned long long   total_;
+
+    size_t Cell (unsigned long long h, size_t r) const
+    {
+      unsigned long long h1 = h & 0xFFFFFFFFULL, h2 = (h >> 32) | 1;
+      return r * width_ + (size_t)((h1 + r * h2) & (width_ - 1));
+    }
+
+    CountMin (const CountMin&);            // not copyable
+    CountMin& operator = (const CountMin&);
+  } ;
+
+  inline bool CountMin::Reset (size_t budget, size_t depth)
+  {
+    delete [] count_;
+    count_ = nullptr;
+    width_ = depth_ = 0;
+    total_ = 0;
+    if (depth == 0)
+      return 1;
+    size_t width = 1024;
+    while (2 * width * depth * sizeof(unsigned long long) <= budget) width *= 2;
+    count_ = new(std::nothrow) unsigned long long [width * depth];
+    if (count_ == nullptr)
+    {
+      std::cerr << "** CountMin memory allocation failure\n";
+      return 0;
+    }
+    width_ = width;
+    depth_ = depth;
+    Clear();
+    return 1;
+  }
+
+  inline void CountMin::Clear ()
+  {
+    for (size_t i = 0; i < width_ * depth_; ++i)
+      count_[i] = 0;
+    total_ = 0;
+  }
+
+  inline unsigned long long CountMin::Estimate (unsigned long long h) const
+  {
+    if (depth_ == 0)
+      return 0;
+    unsigned long long e = count_[Cell(h, 0)];
+    for (size_t r = 1; r < depth_; ++r)
+    {
+      unsigned long long c = count_[Cell(h, r)];
+      if (c < e) e = c;
+    }
+    return e;
+  }
+
+  inline unsigned long long CountMin::Add (unsigned long long h, unsigned long long n)
+  {
+    if (depth_ == 0)
+      return 0;
+    total_ += n;
+    unsigned long long e = Estimate(h) + n;
+    for (size_t r = 0; r < depth_; ++r)
+    {
+      unsigned long long& c = count_[Cell(h, r)];
+      if (c < e) c = e;
+    }
+    return e;
+  }
+
+  class HyperLogLog
+  {
+  public:
+    HyperLogLog  () : reg_(nullptr), p_(0) {}
+    ~HyperLogLog () { delete [] reg_; }
+
+    bool   Reset    (size_t p = 14);  // 2^p registers, 7 <= p <= 18
+    void   Clear    ();
+    void   Add      (unsigned long long h)
+    {
+      size_t i = (size_t)(h >> (64 - p_));
+      unsigned long long rest = (h << p_) | ((unsigned long long)1 << (p_ - 1)); // stops the count at 64 - p
+      uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+      if (rank > reg_[i]) reg_[i] = rank;
+    }
+    double Estimate () const;
+
+    size_t Memory   () const { return p_ ? (size_t)1 << p_ : 0; }
+    double Error    () const { return p_ ? 1.04 / std::sqrt((double)Memory()) : 0; } // relative standard error
+
+  private:
+    uint8_t * reg_;
+    size_t    p_;
+
+    HyperLogLog (const HyperLogLog&);            // not copyable
+    HyperLogLog& operator = (const HyperLogLog&);
+  } ;
+
+  inline bool HyperLogLog::Reset (size_t p)
+  {
+    delete [] reg_;
+    reg_ = nullptr;
+    p_ = 0;
+    if (p < 7 || p > 18)
+      return 0;
+    reg_ = new(std::nothrow) uint8_t [(size_t)1 << p];
+    if (reg_ == nullptr)
+    {
+      std::cerr << "** HyperLogLog memory allocation failure\n";
+      return 0;
+    }
+    p_ = p;
+    Clear();
+    return 1;
+  }
+
+  inline void HyperLogLog::Clear ()
+  {
+    for (size_t i = 0; i < Memory(); ++i)
+      reg_[i] = 0;
+  }
+
+  inline double HyperLogLog::Estimate () const
+  {
+    if (p_ == 0)
+      return 0;
+    double m = (double)Memory(), sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < Memory(); ++i)
+    {
+      sum += std::ldexp(1.0, -(int)reg_[i]);
+      zeros += (reg_[i] == 0);
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    if (e <= 2.5 * m && zeros > 0) // small range: linear counting
+      e = m * std::log(m / (double)zeros);
+    return e;
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,277 @@
+/*
+    textbuffer.h
+    Andrew J Wood
+
+    Buffered column output for table reports.
+
+    TextBuffer collects formatted text in a large char buffer and hands it to
+    the underlying stream with one write() per buffer load. Field() pads a
+    value to a column width exactly as operator << does after std::setw()
+    under the same adjustfield flag and fill character, so a report written
+    through TextBuffer is byte-identical to one written field by field.
+
+    TextFormat<T> converts a value to text without a stream. It is enabled for
+    fsu::String, C-strings and the integer types (char types and bool excluded,
+    since the stream prints those differently); the primary template turns it
+    off, and clients fall back to operator <<. Integer text is only the same
+    as the stream's when the stream prints plain decimal: see PlainDecimal().
+*/
+
+#ifndef _TEXTBUFFER_H
+#define _TEXTBUFFER_H
+
+#include <cstddef>    // size_t
+#include <cstring>    // strlen, memcpy, memset
+#include <iostream>
+#include <locale>     // numpunct
+#include <new>        // std::nothrow
+#include <xstring.h>  // fsu::String
+
+namespace fsu
+{
+
+  class TextBuffer
+  {
+  public:
+    explicit TextBuffer (std::ostream& os, size_t size = 65536);
+    ~TextBuffer () { Flush(); delete [] buf_; }
+
+    void Put   (char c);
+    void Put   (const char* s, size_t n);
+    void Fill  (char c, size_t n);
+    void Flush ();
+
+    // s[0,n) in a field of the given width, as os << std::setw(width) << s would
+    // pad it under adjust (the adjustfield bits); numeric text pads after a leading
+    // '-' when adjust is internal
+    void Field (const char* s, size_t n, int width, std::ios_base::fmtflags adjust,
+                char fill, bool numeric);
+
+  private:
+    std::ostream& os_;
+    char *        buf_;
+    size_t        cap_, end_; // capacity is 0 if the allocation failed: write through
+
+    TextBuffer (const TextBuffer&);            // not copyable
+    TextBuffer& operator = (const TextBuffer&);
+  } ;
+
+  // true when os prints integers in plain decimal: no showpos, decimal base, no
+  // digit grouping in its locale
+  inline bool PlainDecimal (const std::ostream& os)
+  {
+    std::ios_base::fmtflags f = os.flags();
+    if ((f & std::ios_base::showpos) != 0)
+      return 0;
+    if ((f & std::ios_base::basefield) != std::ios_base::dec && (f & std::ios_base::basefield) != 0)
+      return 0;
+    return std::use_facet< std::numpunct<char> >(os.getloc()).grouping().empty();
+  }
+
+  template < typename T >
+  class TextFormat
+  {
+  public:
+    enum { Size = 1 }; // scratch space Text() needs
+    static const bool enabled = false;
+    static const bool numeric = false;
+    static const char* Text (const T& , char* , size_t& n) { n = 0; return nullptr; }
+  } ;
+
+  // Text() returns the characters of a value and sets n to their count; it may use
+  // scratch[0,Size). A nullptr return means operator << would print nothing at all.
+
+  template <>
+  class TextFormat < String >
+  {
+  public:
+    enum { Size = 1 };
+    static const bool enabled = true;
+    static const bool numeric = false;
+    static const char* Text (const String& s, char* , size_t& n)
+    {
+      const char* p = s.Cstr();
+      n = (p != nullptr) ? strlen(p) : 0; // operator << stops at the first '\0' too
+      return p;
+    }
+  } ;
+
+  template <>
+  class TextFormat < const char* >
+  {
+  public:
+    enum { Size = 1 };
+    static const bool enabled = true;
+    static const bool numeric = false;
+    static const char* Text (const char* s, char* , size_t& n)
+    {
+      n = (s != nullptr) ? strlen(s) : 0;
+      return s;
+    }
+  } ;
+
+  // unsigned magnitude to decimal, right to left, two digits per step
+  inline char* UnsignedText (unsigned long long x, char* end)
+  {
+    static const char pairs[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+    char* p = end;
+    while (x >= 100)
+    {
+      const char* d = pairs + 2 * (x % 100);
+      x /= 100;
+      *--p = d[1];
+      *--p = d[0];
+    }
+    if (x >= 10)
+    {
+      *--p = pairs[2 * x + 1];
+      *--p = pairs[2 * x];
+    }
+    else
+      *--p = (char)('0' + x);
+    return p;
+  }
+
+  template < typename U >
+  class UnsignedTextFormat
+  {
+  public:
+    enum { Size = 24 };
+    static const bool enabled = true;
+    static const bool numeric = true;
+    static const char* Text (U x, char* scratch, size_t& n)
+    {
+      char* p = UnsignedText(x, scratch + Size);
+      n = (scratch + Size) - p;
+      return p;
+    }
+  } ;
+
+  template < typename S , typename U >
+  class SignedTextFormat
+  {
+  public:
+    enum { Size = 24 };
+    static const bool enabled = true;
+    static const bool numeric = true;
+    static const char* Text (S x, char* scratch, size_t& n)
+    {
+      U mag = (x < 0) ? (U)0 - (U)x : (U)x;
+      char* p = UnsignedText(mag, scratch + Size);
+      if (x < 0)
+        *--p = '-';
+      n = (scratch + Size) - p;
+      return p;
+    }
+  } ;
+
+  template <> class TextFormat < unsigned short >     : public UnsignedTextFormat < unsigned short >     {} ;
+  template <> class TextFormat < unsigned int >       : public UnsignedTextFormat < unsigned int >       {} ;
+  template <> class TextFormat < unsigned long >      : public UnsignedTextFormat < unsigned long >      {} ;
+  template <> class TextFormat < unsigned long long > : public UnsignedTextFormat < unsigned long long > {} ;
+  template <> class TextFormat < short >     : public SignedTextFormat < short , unsigned short >         {} ;
+  template <> class TextFormat < int >       : public SignedTextFormat < int , unsigned int >             {} ;
+  template <> class TextFormat < long >      : public SignedTextFormat < long , unsigned long >           {} ;
+  template <> class TextFormat < long long > : public SignedTextFormat < long long , unsigned long long > {} ;
+
+  inline TextBuffer::TextBuffer (std::ostream& os, size_t size)
+    : os_(os), buf_(nullptr), cap_(0), end_(0)
+  {
+    if (size > 0)
+      buf_ = new(std::nothrow) char [size];
+    if (buf_ == nullptr)
+      std::cerr << "** TextBuffer memory allocation failure\n";
+    else
+      cap_ = size;
+  }
+
+  inline void TextBuffer::Flush ()
+  {
+    if (end_ > 0)
+      os_.write(buf_, end_);
+    end_ = 0;
+  }
+
+  inline void TextBuffer::Put (char c)
+  {
+    if (end_ == cap_)
+    {
+      Flush();
+      if (cap_ == 0)
+      {
+        os_.put(c);
+        return;
+      }
+    }
+    buf_[end_++] = c;
+  }
+
+  inline void TextBuffer::Put (const char* s, size_t n)
+  {
+    if (n == 0)
+      return;
+    if (n > cap_ - end_)
+    {
+      Flush();
+      if (n > cap_) // too big to buffer
+      {
+        os_.write(s, n);
+        return;
+      }
+    }
+    memcpy(buf_ + end_, s, n);
+    end_ += n;
+  }
+
+  inline void TextBuffer::Fill (char c, size_t n)
+  {
+    while (n > 0)
+    {
+      if (end_ == cap_)
+      {
+        Flush();
+        if (cap_ == 0) // no buffer: one char at a time
+        {
+          os_.put(c);
+          --n;
+          continue;
+        }
+      }
+      size_t k = (n < cap_ - end_) ? n : cap_ - end_;
+      memset(buf_ + end_, c, k);
+      end_ += k;
+      n -= k;
+    }
+  }
+
+  inline void TextBuffer::Field (const char* s, size_t n, int width, std::ios_base::fmtflags adjust,
+                                 char fill, bool numeric)
+  {
+    size_t pad = (width > 0 && (size_t)width > n) ? (size_t)width - n : 0;
+    adjust &= std::ios_base::adjustfield;
+    if (pad == 0)
+      Put(s, n);
+    else if (adjust == std::ios_base::left)
+    {
+      Put(s, n);
+      Fill(fill, pad);
+    }
+    else if (adjust == std::ios_base::internal && numeric && n > 0 && s[0] == '-')
+    {
+      Put(s[0]);
+      Fill(fill, pad);
+      Put(s + 1, n - 1);
+    }
+    else
+    {
+      Fill(fill, pad);
+      Put(s, n);
+    }
+  }
+
+} // namespace fsu
+
+#endif
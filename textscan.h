@@ -0,0 +1,291 @@
+/*
+    textscan.h
+    Andrew J Wood
+
+    Vectorized byte scanning for the WordSmith tokenizer.
+
+    TextScan finds word boundaries and classifies word characters 16 or 32
+    bytes per step. SkipSpace() passes over the characters fsu::String's
+    operator >> skips before a word (isspace() in the "C" locale); ScanWord()
+    finds the ' ', '\n' or '\t' that ends a word and reports, in kind, whether
+    the bytes before it were all lowercase letters and digits (0), included
+    uppercase letters but were otherwise alphanumeric (UPPER), or included
+    anything else (OTHER). Lower() lowercases ASCII letters in bulk.
+
+    On x86 the implementation is chosen once, at first use, from what the CPU
+    supports: AVX2, SSE2, or plain scalar code. The vector code only loads
+    whole blocks inside the range it is given and finishes with the scalar
+    code, so it never reads past the end of a mapping. Every level returns
+    the same results; SetLevel() forces a lower one, for testing.
+*/
+
+#ifndef _TEXTSCAN_H
+#define _TEXTSCAN_H
+
+#include <cstddef>    // size_t
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define _TEXTSCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace fsu
+{
+
+  class TextScan
+  {
+  public:
+    enum Kind  { UPPER = 1, OTHER = 2 };         // bits of ScanWord()'s kind
+    enum Level { SCALAR, SSE2, AVX2 };
+
+    static const char* SkipSpace (const char* p, const char* end) { return Use().skipSpace(p, end); }
+    static const char* ScanWord  (const char* p, const char* end, unsigned& kind) // kind |= classes seen
+    {
+      return Use().scanWord(p, end, kind);
+    }
+    static void        Lower     (const char* s, size_t n, char* out) { Use().lower(s, n, out); } // out may be s
+
+    static Level       GetLevel  () { return Use().level; }
+    static const char* LevelName () { return Use().name; }
+    static bool        SetLevel  (Level level); // false if the CPU lacks it
+
+  private:
+    struct Kernels
+    {
+      const char* (*skipSpace) (const char*, const char*);
+      const char* (*scanWord)  (const char*, const char*, unsigned&);
+      void        (*lower)     (const char*, size_t, char*);
+      Level        level;
+      const char*  name;
+    };
+
+    static Kernels& Use ()
+    {
+      static Kernels k = Select(Best());
+      return k;
+    }
+    static Level   Best   ();
+    static Kernels Select (Level level);
+
+    // scalar kernels: also the tails of the vector ones
+    static bool IsSpace (char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+    static bool IsBreak (char c) { return c == ' ' || c == '\n' || c == '\t'; }
+
+    static const char* SkipSpaceScalar (const char* p, const char* end)
+    {
+      while (p < end && IsSpace(*p)) ++p;
+      return p;
+    }
+    static const char* ScanWordScalar (const char* p, const char* end, unsigned& kind)
+    {
+      for (; p < end && !IsBreak(*p); ++p)
+      {
+        char c = *p;
+        if (c >= 'A' && c <= 'Z')
+          kind |= UPPER;
+        else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')))
+          kind |= OTHER;
+      }
+      return p;
+    }
+    static void LowerScalar (const char* s, size_t n, char* out)
+    {
+      for (size_t i = 0; i < n; ++i)
+        out[i] = (s[i] >= 'A' && s[i] <= 'Z') ? (char)(s[i] + ('a' - 'A')) : s[i];
+    }
+
+#ifdef _TEXTSCAN_X86
+    // in [lo,hi] for ASCII bounds: signed compares, so bytes >= 0x80 are never in range
+    __attribute__((target("sse2")))
+    static __m128i InRange16 (__m128i v, char lo, char hi)
+    {
+      return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                           _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+    }
+    __attribute__((target("sse2")))
+    static unsigned BreakMask16 (__m128i v)
+    {
+      __m128i b = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))));
+      return (unsigned)_mm_movemask_epi8(b);
+    }
+
+    __attribute__((target("sse2")))
+    static const char* SkipSpaceSSE2 (const char* p, const char* end)
+    {
+      for (; end - p >= 16; p += 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), InRange16(v, '\t', '\r'));
+        unsigned other = ~(unsigned)_mm_movemask_epi8(s) & 0xFFFFu;
+        if (other != 0)
+          return p + __builtin_ctz(other);
+      }
+      return SkipSpaceScalar(p, end);
+    }
+
+    __attribute__((target("sse2")))
+    static const char* ScanWordSSE2 (const char* p, const char* end, unsigned& kind)
+    {
+      for (; end - p >= 16; p += 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned brk   = BreakMask16(v);
+        unsigned upper = (unsigned)_mm_movemask_epi8(InRange16(v, 'A', 'Z'));
+        unsigned plain = (unsigned)_mm_movemask_epi8(_mm_or_si128(InRange16(v, 'a', 'z'), InRange16(v, '0', '9')));
+        unsigned word  = brk ? (brk & (0u - brk)) - 1 : 0xFFFFu; // bytes before the first break
+        if (upper & word)
+          kind |= UPPER;
+        if (~(upper | plain) & word)
+          kind |= OTHER;
+        if (brk)
+          return p + __builtin_ctz(brk);
+      }
+      return ScanWordScalar(p, end, kind);
+    }
+
+    __attribute__((target("sse2")))
+    static void LowerSSE2 (const char* s, size_t n, char* out)
+    {
+      size_t i = 0;
+      for (; n - i >= 16; i += 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        v = _mm_add_epi8(v, _mm_and_si128(InRange16(v, 'A', 'Z'), _mm_set1_epi8('a' - 'A')));
+        _mm_storeu_si128((__m128i*)(out + i), v);
+      }
+      LowerScalar(s + i, n - i, out + i);
+    }
+
+    __attribute__((target("avx2")))
+    static __m256i InRange32 (__m256i v, char lo, char hi)
+    {
+      return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char)(lo - 1))),
+                              _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(hi + 1)), v));
+    }
+    __attribute__((target("avx2")))
+    static unsigned BreakMask32 (__m256i v)
+    {
+      __m256i b = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                  _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))));
+      return (unsigned)_mm256_movemask_epi8(b);
+    }
+
+    // the AVX2 kernels try one 16-byte block first: most words and the gaps between them are
+    // shorter than that, and a 32-byte load crosses a cache line twice as often
+    __attribute__((target("avx2")))
+    static const char* SkipSpaceAVX2 (const char* p, const char* end)
+    {
+      if (end - p >= 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), InRange16(v, '\t', '\r'));
+        unsigned other = ~(unsigned)_mm_movemask_epi8(s) & 0xFFFFu;
+        if (other != 0)
+          return p + __builtin_ctz(other);
+        p += 16;
+      }
+      for (; end - p >= 32; p += 32)
+      {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i s = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), InRange32(v, '\t', '\r'));
+        unsigned other = ~(unsigned)_mm256_movemask_epi8(s);
+        if (other != 0)
+          return p + __builtin_ctz(other);
+      }
+      return SkipSpaceSSE2(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    static const char* ScanWordAVX2 (const char* p, const char* end, unsigned& kind)
+    {
+      if (end - p >= 16)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned brk   = BreakMask16(v);
+        unsigned upper = (unsigned)_mm_movemask_epi8(InRange16(v, 'A', 'Z'));
+        unsigned plain = (unsigned)_mm_movemask_epi8(_mm_or_si128(InRange16(v, 'a', 'z'), InRange16(v, '0', '9')));
+        unsigned word  = brk ? (brk & (0u - brk)) - 1 : 0xFFFFu;
+        if (upper & word)
+          kind |= UPPER;
+        if (~(upper | plain) & word)
+          kind |= OTHER;
+        if (brk)
+          return p + __builtin_ctz(brk);
+        p += 16;
+      }
+      for (; end - p >= 32; p += 32)
+      {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        unsigned brk   = BreakMask32(v);
+        unsigned upper = (unsigned)_mm256_movemask_epi8(InRange32(v, 'A', 'Z'));
+        unsigned plain = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(InRange32(v, 'a', 'z'), InRange32(v, '0', '9')));
+        unsigned word  = brk ? (brk & (0u - brk)) - 1 : ~0u; // bytes before the first break
+        if (upper & word)
+          kind |= UPPER;
+        if (~(upper | plain) & word)
+          kind |= OTHER;
+        if (brk)
+          return p + __builtin_ctz(brk);
+      }
+      return ScanWordSSE2(p, end, kind);
+    }
+
+    __attribute__((target("avx2")))
+    static void LowerAVX2 (const char* s, size_t n, char* out)
+    {
+      size_t i = 0;
+      for (; n - i >= 32; i += 32)
+      {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+        v = _mm256_add_epi8(v, _mm256_and_si256(InRange32(v, 'A', 'Z'), _mm256_set1_epi8('a' - 'A')));
+        _mm256_storeu_si256((__m256i*)(out + i), v);
+      }
+      LowerSSE2(s + i, n - i, out + i);
+    }
+#endif
+  } ;
+
+  inline TextScan::Level TextScan::Best ()
+  {
+#ifdef _TEXTSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return AVX2;
+    if (__builtin_cpu_supports("sse2"))
+      return SSE2;
+#endif
+    return SCALAR;
+  }
+
+  inline TextScan::Kernels TextScan::Select (Level level)
+  {
+    Kernels k = { SkipSpaceScalar, ScanWordScalar, LowerScalar, SCALAR, "scalar" };
+#ifdef _TEXTSCAN_X86
+    if (level == AVX2)
+    {
+      Kernels a = { SkipSpaceAVX2, ScanWordAVX2, LowerAVX2, AVX2, "avx2" };
+      k = a;
+    }
+    else if (level == SSE2)
+    {
+      Kernels s = { SkipSpaceSSE2, ScanWordSSE2, LowerSSE2, SSE2, "sse2" };
+      k = s;
+    }
+#else
+    (void)level;
+#endif
+    return k;
+  }
+
+  inline bool TextScan::SetLevel (Level level)
+  {
+    if (level > Best())
+      return 0;
+    Use() = Select(level);
+    return 1;
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,231 @@
+/*
+    textsource.h
+    Andrew J Wood
+
+    Zero-copy word source for text files.
+
+    TextSource::Open() maps a regular file into memory (mmap, with
+    madvise(MADV_SEQUENTIAL) so the kernel reads ahead aggressively) and Next()
+    hands back each word as a pointer and length into the mapping; nothing is
+    copied or allocated per word. Files that cannot be mapped (pipes, devices,
+    empty or special files) are read with read() into a reusable buffer, and a
+    word that runs past the end of the buffer is moved to its front before the
+    next read, so words are never split. A word slice stays valid only until
+    the next call to Next().
+
+    Open(begin, end) reads words from a range of memory the caller owns, such
+    as one chunk of another source's mapping (Data(), Size()); a range that
+    starts and ends at a word break holds exactly the words a source over the
+    whole input would return for it.
+
+    Words are delimited exactly as fsu::String's operator >> delimits them:
+    leading characters for which isspace() holds in the "C" locale are
+    skipped, and the word then runs to the next ' ', '\n' or '\t' (so a '\r',
+    '\v' or '\f' inside a word is part of it). The scanning is done by
+    TextScan (textscan.h), which also classifies the characters of each word
+    for the three-argument Next().
+*/
+
+#ifndef _TEXTSOURCE_H
+#define _TEXTSOURCE_H
+
+#include <cstddef>      // size_t
+#include <cstring>      // memmove
+#include <cerrno>       // errno, EINTR
+#include <iostream>     // std::cerr
+#include <new>          // std::nothrow
+#include <textscan.h>   // TextScan
+#include <fcntl.h>      // open
+#include <unistd.h>     // read, close
+#include <sys/mman.h>   // mmap, madvise, munmap
+#include <sys/stat.h>   // fstat
+
+namespace fsu
+{
+
+  class TextSource
+  {
+  public:
+    TextSource  ();
+    ~TextSource () { Close(); }
+
+    bool Open   (const char* path, size_t bufSize = 1 << 20); // bufSize used only if not mapped
+    void Open   (const char* begin, const char* end);         // words of [begin,end), not owned
+    void Close  ();
+    bool Next   (const char*& word, size_t& n); // false at end of input
+    bool Next   (const char*& word, size_t& n, unsigned& kind); // kind: TextScan classes of the word
+
+    bool Mapped () const { return map_ != nullptr; }
+    bool Error  () const { return error_; }     // a read() failed; input ended early
+
+    const char* Data () const { return map_; }   // the mapped file, if Mapped()
+    size_t      Size () const { return mapSize_; }
+    size_t      Offset () const { return done_ + (size_t)(cur_ - base_); } // bytes of input scanned so far
+
+    static bool IsBreak (char c) // ends a word
+    {
+      return c == ' ' || c == '\n' || c == '\t';
+    }
+
+  private:
+    int     fd_;
+    char *  map_;
+    size_t  mapSize_;
+    char *  buf_;
+    size_t  cap_;
+    bool    eof_, error_;
+    const char * cur_;  // unscanned input is [cur_,lim_)
+    const char * lim_;
+    const char * base_; // input byte done_ is at base_
+    size_t  done_;
+
+    bool Refill ();     // read mode: keep [cur_,lim_), append more input; false if none came
+
+    TextSource (const TextSource&);            // not copyable
+    TextSource& operator = (const TextSource&);
+  } ;
+
+  inline TextSource::TextSource ()
+    : fd_(-1), map_(nullptr), mapSize_(0), buf_(nullptr), cap_(0), eof_(0), error_(0), cur_(nullptr), lim_(nullptr),
+      base_(nullptr), done_(0)
+  {}
+
+  inline bool TextSource::Open (const char* path, size_t bufSize)
+  {
+    Close();
+    if (path == nullptr)
+      return 0;
+    fd_ = open(path, O_RDONLY);
+    if (fd_ < 0)
+      return 0;
+
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      void * m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+      if (m != MAP_FAILED)
+      {
+        madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL); // advice only; failure is harmless
+        map_ = (char*)m;
+        mapSize_ = (size_t)st.st_size;
+        cur_ = base_ = map_;
+        lim_ = map_ + mapSize_;
+        eof_ = 1;
+        close(fd_); // the mapping keeps the file
+        fd_ = -1;
+        return 1;
+      }
+    }
+
+    // not mappable: buffered read()
+    if (bufSize < 4096) bufSize = 4096;
+    buf_ = new(std::nothrow) char [bufSize];
+    if (buf_ == nullptr)
+    {
+      std::cerr << "** TextSource memory allocation failure\n";
+      Close();
+      return 0;
+    }
+    cap_ = bufSize;
+    cur_ = lim_ = base_ = buf_;
+    return 1;
+  }
+
+  inline void TextSource::Open (const char* begin, const char* end)
+  {
+    Close();
+    cur_ = base_ = begin;
+    lim_ = end;
+    eof_ = 1;
+  }
+
+  inline void TextSource::Close ()
+  {
+    if (map_ != nullptr)
+      munmap(map_, mapSize_);
+    if (fd_ >= 0)
+      close(fd_);
+    delete [] buf_;
+    fd_ = -1;
+    map_ = nullptr;
+    buf_ = nullptr;
+    mapSize_ = cap_ = 0;
+    eof_ = error_ = 0;
+    cur_ = lim_ = base_ = nullptr;
+    done_ = 0;
+  }
+
+  inline bool TextSource::Refill ()
+  {
+    if (eof_)
+      return 0;
+    size_t scanned = (size_t)(cur_ - base_);
+    size_t keep = (cur_ < lim_) ? (size_t)(lim_ - cur_) : 0;
+    if (keep == cap_) // one word fills the buffer: double it
+    {
+      char * bigger = new(std::nothrow) char [2 * cap_];
+      if (bigger == nullptr)
+      {
+        std::cerr << "** TextSource memory allocation failure\n";
+        error_ = 1;
+        eof_ = 1;
+        return 0;
+      }
+      memcpy(bigger, cur_, keep);
+      delete [] buf_;
+      buf_ = bigger;
+      cap_ *= 2;
+    }
+    else if (keep > 0 && cur_ != buf_)
+      memmove(buf_, cur_, keep);
+    done_ += scanned;
+    cur_ = base_ = buf_;
+    lim_ = buf_ + keep;
+
+    ssize_t got;
+    do
+      got = read(fd_, buf_ + keep, cap_ - keep);
+    while (got < 0 && errno == EINTR);
+    if (got <= 0)
+    {
+      error_ = (got < 0);
+      eof_ = 1;
+      return 0;
+    }
+    lim_ += got;
+    return 1;
+  }
+
+  inline bool TextSource::Next (const char*& word, size_t& n)
+  {
+    unsigned kind;
+    return Next(word, n, kind);
+  }
+
+  inline bool TextSource::Next (const char*& word, size_t& n, unsigned& kind)
+  {
+    for (;;)
+    {
+      cur_ = TextScan::SkipSpace(cur_, lim_);
+      if (cur_ < lim_)
+        break;
+      if (!Refill())
+        return 0;
+    }
+    size_t len = 0;
+    kind = 0;
+    for (;;)
+    {
+      len = TextScan::ScanWord(cur_ + len, lim_, kind) - cur_;
+      if (cur_ + len < lim_ || !Refill()) // Refill() moves the word to the buffer front
+        break;
+    }
+    word = cur_;
+    n = len;
+    cur_ += len;
+    return 1;
+  }
+
+} // namespace fsu
+
+#endif
@@ -0,0 +1,278 @@
+/*
+    topk.h
+    Andrew J Wood
+
+    TopK<K,D,P> keeps the k highest-ranked (key, data) pairs it is offered in
+    a size-k min-heap, so that offering n pairs costs O(n log k) and memory
+    stays O(k). A pair ranks above another if its data is larger, or if the
+    data are equal and its key comes first under P; the heap root is the
+    lowest-ranked pair kept, and a new pair enters only if it outranks it.
+
+    Offer() treats every pair as a new key, which suits one pass over a table.
+    Update() is for keys whose data change while they are being ranked, such
+    as word counts during a read: it finds a key already in the heap through a
+    small hash index of heap slots (2k buckets, linear probing, keys never
+    copied) and moves it to its new place. Update() is exact as long
+    as each key's data never decreases and every change is passed to it.
+
+    Sorted() writes the kept pairs in rank order (highest first) and costs
+    O(k log k).
+*/
+
+#ifndef _TOPK_H
+#define _TOPK_H
+
+#include <cstddef>    // size_t
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+#include <algorithm>  // std::sort
+#include <compare.h>  // LessThan
+#include <hashfunctions.h> // Hash
+
+namespace fsu
+{
+
+  template < typename K , typename D , class P = LessThan<K> , class H = Hash<K> >
+  class TopK
+  {
+  public:
+    struct Entry
+    {
+      K key;
+      D data;
+    };
+
+    TopK  () : entry_(nullptr), heap_(nullptr), pos_(nullptr), hash_(nullptr), bucket_(nullptr),
+               size_(0), cap_(0), mask_(0), pred_(), hasher_() {}
+    explicit TopK (P p) : entry_(nullptr), heap_(nullptr), pos_(nullptr), hash_(nullptr), bucket_(nullptr),
+               size_(0), cap_(0), mask_(0), pred_(p), hasher_() {}
+    ~TopK () { Release(); }
+
+    bool   Reset    (size_t k);              // empty, keeping at most k pairs
+    void   Clear    () { Reset(cap_); }
+    void   Offer    (const K& key, const D& data);
+    void   Update   (const K& key, const D& data);
+
+    size_t Size     () const { return size_; }
+    size_t Capacity () const { return cap_; }
+    size_t Sorted   (Entry* out) const;      // out has room for Size(); returns Size()
+
+  private:
+    // a pair stays in its entry_ slot while it is kept; the heap orders slot numbers, so
+    // sifting moves no keys and the index changes only when a key enters or leaves
+    Entry *  entry_;
+    size_t * heap_;                          // heap_[i] = slot at heap position i
+    size_t * pos_;                           // pos_[slot] = its heap position
+    size_t * hash_;                          // hash_[slot] = hash of its key, if indexed
+    size_t * bucket_;                        // index: slot + 1, or 0 if empty; kept by Update() only
+    size_t   size_, cap_, mask_;
+    P        pred_;
+    H        hasher_;
+
+    bool Above (const Entry& a, const Entry& b) const // a ranks above b
+    {
+      return b.data < a.data || (!(a.data < b.data) && pred_(a.key, b.key));
+    }
+    bool Above (const K& key, const D& data, const Entry& b) const
+    {
+      return b.data < data || (!(data < b.data) && pred_(key, b.key));
+    }
+    bool Above (size_t i, size_t j) const { return Above(entry_[heap_[i]], entry_[heap_[j]]); } // heap positions
+
+    void Release  ();
+    size_t Bucket (const K& key, size_t h) const; // holding key's slot, or the empty one that would
+    void   Unindex(size_t b);                      // empties bucket b
+    void Swap     (size_t i, size_t j) // heap positions
+    {
+      size_t t = heap_[i]; heap_[i] = heap_[j]; heap_[j] = t;
+      pos_[heap_[i]] = i;
+      pos_[heap_[j]] = j;
+    }
+    void SiftUp   (size_t i);
+    void SiftDown (size_t i);
+    size_t Push   (const K& key, const D& data); // returns the slot used
+    size_t Root   (const K& key, const D& data); // replaces the root pair; returns its slot
+
+    class RankOrder
+    {
+    public:
+      explicit RankOrder (const TopK& t) : t_(t) {}
+      bool operator () (const Entry& a, const Entry& b) const { return t_.Above(a, b); }
+    private:
+      const TopK& t_;
+    };
+
+    TopK (const TopK&);            // not copyable
+    TopK& operator = (const TopK&);
+  } ;
+
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::Release ()
+  {
+    delete [] entry_;
+    delete [] heap_;
+    delete [] pos_;
+    delete [] hash_;
+    delete [] bucket_;
+    entry_ = nullptr;
+    heap_ = pos_ = hash_ = bucket_ = nullptr;
+    cap_ = mask_ = 0;
+  }
+
+  template < typename K , typename D , class P , class H >
+  bool TopK<K,D,P,H>::Reset (size_t k)
+  {
+    size_ = 0;
+    if (k != cap_)
+    {
+      Release();
+      if (k > 0)
+      {
+        size_t buckets = 2;
+        while (buckets < 2 * k) buckets *= 2; //at most half full
+        entry_ = new(std::nothrow) Entry [k];
+        heap_ = new(std::nothrow) size_t [k];
+        pos_ = new(std::nothrow) size_t [k];
+        hash_ = new(std::nothrow) size_t [k];
+        bucket_ = new(std::nothrow) size_t [buckets];
+        if (entry_ == nullptr || heap_ == nullptr || pos_ == nullptr || hash_ == nullptr || bucket_ == nullptr)
+        {
+          std::cerr << "** TopK memory allocation failure\n";
+          Release();
+          return 0;
+        }
+        cap_ = k;
+        mask_ = buckets - 1;
+      }
+    }
+    for (size_t b = 0; cap_ > 0 && b <= mask_; ++b)
+      bucket_[b] = 0;
+    return 1;
+  }
+
+  template < typename K , typename D , class P , class H >
+  size_t TopK<K,D,P,H>::Bucket (const K& key, size_t h) const
+  {
+    size_t b = h & mask_;
+    for (; bucket_[b] != 0; b = (b + 1) & mask_)
+    {
+      size_t slot = bucket_[b] - 1;
+      if (hash_[slot] == h && !pred_(key, entry_[slot].key) && !pred_(entry_[slot].key, key))
+        break;
+    }
+    return b;
+  }
+
+  // backward shift: move up each later member of the run that may live at or before b
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::Unindex (size_t b)
+  {
+    for (size_t j = (b + 1) & mask_; bucket_[j] != 0; j = (j + 1) & mask_)
+    {
+      size_t home = hash_[bucket_[j] - 1] & mask_;
+      if (((j - home) & mask_) >= ((j - b) & mask_))
+      {
+        bucket_[b] = bucket_[j];
+        b = j;
+      }
+    }
+    bucket_[b] = 0;
+  }
+
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::SiftUp (size_t i)
+  {
+    while (i > 0 && Above((i - 1) / 2, i))
+    {
+      Swap(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::SiftDown (size_t i)
+  {
+    for (;;)
+    {
+      size_t c = 2 * i + 1;
+      if (c >= size_)
+        break;
+      if (c + 1 < size_ && Above(c, c + 1))
+        ++c; //the lower-ranked child
+      if (!Above(i, c))
+        break;
+      Swap(i, c);
+      i = c;
+    }
+  }
+
+  template < typename K , typename D , class P , class H >
+  size_t TopK<K,D,P,H>::Push (const K& key, const D& data)
+  {
+    size_t slot = size_++;
+    entry_[slot].key = key;
+    entry_[slot].data = data;
+    heap_[slot] = slot;
+    pos_[slot] = slot;
+    SiftUp(slot);
+    return slot;
+  }
+
+  template < typename K , typename D , class P , class H >
+  size_t TopK<K,D,P,H>::Root (const K& key, const D& data)
+  {
+    size_t slot = heap_[0];
+    entry_[slot].key = key;
+    entry_[slot].data = data;
+    SiftDown(0);
+    return slot;
+  }
+
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::Offer (const K& key, const D& data)
+  {
+    if (size_ < cap_)
+      Push(key, data);
+    else if (cap_ > 0 && Above(key, data, entry_[heap_[0]]))
+      Root(key, data);
+  }
+
+  template < typename K , typename D , class P , class H >
+  void TopK<K,D,P,H>::Update (const K& key, const D& data)
+  {
+    if (cap_ == 0)
+      return;
+    if (size_ == cap_ && !Above(key, data, entry_[heap_[0]])) //cannot be kept, so it is not in the heap either
+      return;
+    size_t h = hasher_(key);
+    size_t b = Bucket(key, h);
+    if (bucket_[b] != 0)
+    {
+      size_t slot = bucket_[b] - 1;
+      entry_[slot].data = data; //data only grows: the pair can only move away from the root
+      SiftDown(pos_[slot]);
+      return;
+    }
+    if (size_ == cap_) //evict the root
+    {
+      size_t root = heap_[0];
+      Unindex(Bucket(entry_[root].key, hash_[root]));
+      b = Bucket(key, h); //the shift may have moved the empty bucket
+    }
+    size_t slot = (size_ < cap_) ? Push(key, data) : Root(key, data);
+    hash_[slot] = h;
+    bucket_[b] = slot + 1;
+  }
+
+  template < typename K , typename D , class P , class H >
+  size_t TopK<K,D,P,H>::Sorted (Entry* out) const
+  {
+    for (size_t i = 0; i < size_; ++i)
+      out[i] = entry_[i];
+    std::sort(out, out + size_, RankOrder(*this));
+    return size_;
+  }
+
+} // namespace fsu
+
+#endif
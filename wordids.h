@@ -0,0 +1,148 @@
+/*
+    wordids.h
+    Andrew J Wood
+
+    WordIds interns words: each distinct word is given the next 32-bit ID
+    (0, 1, 2, ...) and stored once, so that structures indexed by word can
+    hold a fixed-width ID instead of the text. The index is an open-addressing
+    table of IDs, at most half full, that compares words only when their
+    stored hashes match. Used by the n-gram counter (ngram.h) and the
+    inverted index (postings.h).
+*/
+
+#ifndef _WORDIDS_H
+#define _WORDIDS_H
+
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t
+#include <iostream>   // std::cerr
+#include <new>        // std::nothrow
+#include <xstring.h>  // fsu::String
+#include <hashfunctions.h> // Hash
+
+namespace fsu
+{
+
+  class WordIds
+  {
+  public:
+    static const uint32_t NoId = 0xFFFFFFFFu;
+
+    WordIds  () : words_(nullptr), hashes_(nullptr), bucket_(nullptr), size_(0), cap_(0), mask_(0), hasher_() {}
+    ~WordIds () { Clear(); }
+
+    uint32_t      Id   (const String& word);  // numbers new words in turn; NoId if out of memory
+    uint32_t      Find (const String& word) const; // NoId if word has none
+    const String& Word (uint32_t id) const { return words_[id]; }
+    size_t        Size () const { return size_; }
+    void          Clear ();
+
+  private:
+    String *   words_;   // words_[id]
+    size_t *   hashes_;  // hashes_[id]
+    uint32_t * bucket_;  // id + 1, or 0 if empty
+    size_t     size_, cap_, mask_;
+    Hash<String> hasher_;
+
+    size_t Bucket (const String& word, size_t h) const; // holding word's ID, or the empty one that would
+    bool   Grow   ();
+
+    WordIds (const WordIds&);            // not copyable
+    WordIds& operator = (const WordIds&);
+  } ;
+
+  inline size_t WordIds::Bucket (const String& word, size_t h) const
+  {
+    size_t b = h & mask_;
+    for (; bucket_[b] != 0; b = (b + 1) & mask_)
+    {
+      size_t id = bucket_[b] - 1;
+      if (hashes_[id] == h && words_[id] == word)
+        break;
+    }
+    return b;
+  }
+
+  inline bool WordIds::Grow ()
+  {
+    size_t cap = cap_ ? 2 * cap_ : 1024;
+    if (cap > (size_t)NoId) cap = NoId; // IDs 0 .. NoId - 1
+    String * words = (cap > cap_) ? new(std::nothrow) String [cap] : nullptr;
+    size_t * hashes = (words != nullptr) ? new(std::nothrow) size_t [cap] : nullptr;
+    uint32_t * bucket = (hashes != nullptr) ? new(std::nothrow) uint32_t [2 * cap] : nullptr;
+    if (bucket == nullptr)
+    {
+      if (cap > cap_)
+        std::cerr << "** WordIds memory allocation failure\n";
+      delete [] words;
+      delete [] hashes;
+      return 0;
+    }
+    for (size_t id = 0; id < size_; ++id)
+    {
+      words[id] = words_[id];
+      hashes[id] = hashes_[id];
+    }
+    delete [] words_;
+    delete [] hashes_;
+    delete [] bucket_;
+    words_ = words;
+    hashes_ = hashes;
+    bucket_ = bucket;
+    cap_ = cap;
+    mask_ = 2 * cap - 1;
+    for (size_t b = 0; b <= mask_; ++b)
+      bucket_[b] = 0;
+    for (size_t id = 0; id < size_; ++id) // IDs are distinct words: no compares needed
+    {
+      size_t b = hashes_[id] & mask_;
+      while (bucket_[b] != 0) b = (b + 1) & mask_;
+      bucket_[b] = (uint32_t)(id + 1);
+    }
+    return 1;
+  }
+
+  inline uint32_t WordIds::Id (const String& word)
+  {
+    size_t h = hasher_(word);
+    size_t b = 0;
+    if (cap_ > 0)
+    {
+      b = Bucket(word, h);
+      if (bucket_[b] != 0)
+        return bucket_[b] - 1;
+    }
+    if (size_ == cap_)
+    {
+      if (!Grow())
+        return NoId;
+      b = Bucket(word, h);
+    }
+    words_[size_] = word;
+    hashes_[size_] = h;
+    bucket_[b] = (uint32_t)(size_ + 1);
+    return (uint32_t)size_++;
+  }
+
+  inline uint32_t WordIds::Find (const String& word) const
+  {
+    if (cap_ == 0)
+      return NoId;
+    size_t b = Bucket(word, hasher_(word));
+    return bucket_[b] != 0 ? bucket_[b] - 1 : NoId;
+  }
+
+  inline void WordIds::Clear ()
+  {
+    delete [] words_;
+    delete [] hashes_;
+    delete [] bucket_;
+    words_ = nullptr;
+    hashes_ = nullptr;
+    bucket_ = nullptr;
+    size_ = cap_ = mask_ = 0;
+  }
+
+} // namespace fsu
+
+#endif
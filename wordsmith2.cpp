@@ -12,63 +12,793 @@
 #include <wordsmith2.h> // included to indicate that this is the implementation file
 #include <fstream> // Allows for read access to files
 #include <iomanip>
+#include <new> // std::nothrow
+#include <thread> // std::thread, for parallel ReadText
+#include <system_error>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio> // rename, remove
+#include <cstring> // memcpy, memcmp
+#include <cstdint> // uint32_t
 
-WordSmith::WordSmith() : frequency_(), infiles_(), count_(0)  //default constructor
-{}
+WordSmith::WordSmith() : frequency_(), infiles_(), count_(0), threads_(1), topk_(), grams_(), index_(), indexing_(0), approx_(), spill_()  //default constructor
+{
+    frequency_.SetCache(1024); //word frequencies are Zipfian; let the hot words skip the tree descent
+}
 
 WordSmith::~WordSmith() // destructor
 {} //note - destructors of each element will be called
 
+// adds the counts of a partial table into the frequency set, and to the top words if tracked
+template < class S , class T >
+class AddCounts
+{
+public:
+    AddCounts (S& s, T* t) : s_(s), t_(t) {}
+    template < class E >
+    void operator() (const E* e) const
+    {
+        typename S::DataType& d = s_[e->key_];
+        d += e->data_;
+        if (t_ != nullptr)
+            t_->Update(e->key_, d);
+    }
+private:
+    S& s_;
+    T* t_;
+};
+
+// adds each word of a set, with its count, to approximate counts
+template < class A >
+class FoldCounts
+{
+public:
+    explicit FoldCounts (A& a) : a_(a) {}
+    template < class K , class D >
+    void operator() (const K& key, const D& data) const { a_.Add(key, data); }
+private:
+    A& a_;
+};
+
+// writes each word of a set, with its count, to a sorted run
+template < class W >
+class PutCounts
+{
+public:
+    explicit PutCounts (W& w) : w_(w) {}
+    template < class K , class D >
+    void operator() (const K& key, const D& data) const { w_.Put(key, data); }
+private:
+    W& w_;
+};
+
+// does nothing with each word: a merge that only counts them
+class CountKeys
+{
+public:
+    template < class K , class D >
+    void operator() (const K&, const D&) const {}
+};
+
+// adds up the memory a set's keys own
+class KeyBytes
+{
+public:
+    explicit KeyBytes (size_t& n) : n_(n) {}
+    template < class K , class D >
+    void operator() (const K& key, const D&) const { n_ += key.Size() + 1; }
+private:
+    size_t& n_;
+};
+
+// offers each word of a set to a TopK, through Update() if it is to be kept current
+template < class T >
+class OfferCounts
+{
+public:
+    OfferCounts (T& t, bool tracked) : t_(t), tracked_(tracked) {}
+    template < class K , class D >
+    void operator() (const K& key, const D& data) const
+    {
+        if (tracked_)
+            t_.Update(key, data);
+        else
+            t_.Offer(key, data);
+    }
+private:
+    T&   t_;
+    bool tracked_;
+};
+
 bool WordSmith::ReadText (const fsu::String& infile, bool showProgress)
 {
-    const char * fileForOpen = infile.Cstr();
-    std::ifstream inClientFile(fileForOpen, std::ios::in); //open file for read
+    fsu::TextSource source; //maps the file, or reads it through a buffer if it cannot be mapped
     
-    if (!inClientFile)
+    if (!source.Open(infile.Cstr()))
     {
         return 0; //return 0, indicating file could not be read
     }
     
-    const unsigned long tickerVal = 65536;
-    fsu::String wordString;
+    const size_t minChunk = 1 << 20; //smaller chunks are not worth a thread
+    size_t threads = threads_;
+    if (threads > 1 && source.Mapped() && source.Size() / threads < minChunk)
+        threads = source.Size() / minChunk;
+    if (grams_.Order() > 0 || indexing_ || approx_.On()) //n-grams and the index need the words in order; sketches are not merged
+        threads = 1;
+    if (spill_.On()) //one table, within the limit
+        threads = 1;
+    
     size_t wordCounter = 0;
-    size_t initVocabSize = VocabSize();
+    size_t initVocabSize = VocabBefore();
     
-    while (inClientFile >> wordString) //read words from file separated by whitespace, continue until EOF
+    if (threads > 1 && source.Mapped())
+        wordCounter = ReadParallel(source, threads, showProgress);
+    else
     {
-        WordSmith::Cleanup(wordString); //cleans up the string as per rules
-        
-        if (wordString.Length() != 0) //if cleanup operation resulted in non-zero length string
+        grams_.Restart();
+        StartIndex();
+        fsu::ReadProgress progress(std::cout, source.Mapped() ? source.Size() : 0);
+        if (showProgress)
+            StartProgress(progress, initVocabSize);
+        wordCounter = Count(source, showProgress ? &progress : nullptr);
+    }
+    
+    if (source.Error())
+        std::cerr << "** WordSmith read error in " << infile << "\n";
+    
+    EndRead(infile, wordCounter, initVocabSize);
+    
+    return 1; //operation was successful
+}
+
+bool WordSmith::ReadStream (int fd, const fsu::String& name, bool showProgress)
+{
+    fsu::BlockReader reader; //reads the next block while this thread counts the last one
+    if (fd < 0 || !reader.Open(fd))
+    {
+        return 0;
+    }
+    
+    size_t wordCounter = 0;
+    size_t initVocabSize = VocabBefore();
+    fsu::ReadProgress progress(std::cout, 0); //the total is unknown
+    if (showProgress)
+        StartProgress(progress, initVocabSize);
+    fsu::ReadProgress * report = showProgress ? &progress : nullptr;
+    grams_.Restart();
+    StartIndex();
+    fsu::ByteBuffer cut; //the start of a word the last block ended inside
+    fsu::TextSource words;
+    const char * block;
+    size_t n;
+    bool ok = 1;
+    
+    while (ok && reader.Next(block, n))
+    {
+        const char * p = block, * end = block + n;
+        if (cut.Size() > 0) //the block starts with the rest of that word
         {
-            ++frequency_[wordString]; //get data value based on key value, increment by one if it exists already.
-                                      //if it does not exist, create new and increment to 1.
-            ++wordCounter;            //increment the word Counter for this read
+            const char * b = p;
+            while (b < end && !fsu::TextSource::IsBreak(*b)) ++b;
+            ok = cut.Put(p, b - p);
+            if (!ok || b == end) //the word runs on into the next block
+                continue;
+            words.Open(cut.Data(), cut.Data() + cut.Size());
+            wordCounter += Count(words, report);
+            cut.Clear();
+            p = b;
         }
-        
-        if (showProgress) //if ticker is enabled
+        const char * last = end; //just past the last word break
+        while (last > p && !fsu::TextSource::IsBreak(last[-1])) --last;
+        words.Open(p, last);
+        wordCounter += Count(words, report);
+        ok = cut.Put(last, end - last);
+    }
+    if (ok && cut.Size() > 0) //the last word
+    {
+        words.Open(cut.Data(), cut.Data() + cut.Size());
+        wordCounter += Count(words, report);
+    }
+    
+    if (!ok) //the cut word could not be held: ByteBuffer has reported it
+        std::cerr << "** WordSmith stopped reading " << name << " early\n";
+    if (reader.Error())
+        std::cerr << "** WordSmith read error in " << name << "\n";
+    
+    EndRead(name, wordCounter, initVocabSize);
+    
+    return 1;
+}
+
+void WordSmith::EndRead (const fsu::String& infile, size_t wordCounter, size_t initVocabSize)
+{
+    count_ += wordCounter; //add to count_ var
+    
+    std::cout << "\n\tNumber of words read:    " << wordCounter;
+    
+    if (Spilled()) //the vocabulary is not known until the runs are merged
+        std::cout << "\n\tRuns spilled to disk:    " << spill_.Runs() << "\n";
+    else
+    {
+        size_t vocabSize = VocabSize(); //an estimate may dip as it changes method
+        std::cout << "\n\tNew words in vocabulary: " << (vocabSize > initVocabSize ? vocabSize - initVocabSize : 0) << "\n";
+    }
+    
+    infiles_.PushBack(infile); //pushes the file name to the infiles_ list
+}
+
+struct WordSmith::FileQueue
+{
+    FileJob *               jobs;
+    size_t                  size;
+    std::atomic<size_t>     next; //first job no worker has taken
+    std::mutex              lock; //guards FileJob::done
+    std::condition_variable finished;
+    fsu::NGramCounter *     grams; //counted too, if not null; then there is one worker
+    fsu::Postings *         index; //indexed too, if not null; then there is one worker
+    uint32_t                file; //index number of the next file opened
+    ApproxCounts *          approx; //counted instead of frequency, if not null; then there is one worker
+    TopKType *              topk; //kept with approx
+};
+
+void WordSmith::CountFiles (FileQueue* q)
+{
+    for (size_t i = q->next++; i < q->size; i = q->next++)
+    {
+        FileJob& job = q->jobs[i];
+        fsu::TextSource source;
+        job.opened = source.Open(job.name.Cstr());
+        if (job.opened)
+        {
+            if (q->grams != nullptr)
+                q->grams->Restart();
+            if (q->index != nullptr) //files that cannot be opened are not listed
+                q->index->Start(q->file++);
+            if (q->approx != nullptr) //all files go into one estimate: take this file's share now
+            {
+                size_t before = q->approx->Distinct();
+                job.words = CountWords(source, *q->approx, nullptr, q->topk, q->grams, q->index);
+                size_t after = q->approx->Distinct();
+                job.newWords = after > before ? after - before : 0;
+            }
+            else
+                job.words = CountWords(source, job.frequency, nullptr, nullptr, q->grams, q->index);
+            job.error = source.Error();
+        }
+        std::lock_guard<std::mutex> g(q->lock);
+        job.done = 1;
+        q->finished.notify_all();
+    }
+}
+
+size_t WordSmith::ReadTexts (const fsu::List<fsu::String>& infiles, bool showProgress)
+{
+    size_t numFiles = infiles.Size();
+    if (numFiles == 0)
+        return 0;
+    if (spill_.On()) //counted straight into the one table, a file at a time
+    {
+        size_t numRead = 0;
+        for (fsu::List<fsu::String>::ConstIterator f = infiles.Begin(); f != infiles.End(); ++f)
+        {
+            if (ReadText(*f, showProgress))
+                ++numRead;
+            else
+                std::cout << "    ** Cannot open file " << *f << '\n';
+        }
+        return numRead;
+    }
+    FileQueue q;
+    q.jobs = new(std::nothrow) FileJob [numFiles];
+    size_t numWorkers = (threads_ < numFiles) ? threads_ : numFiles;
+    if (grams_.Order() > 0 || indexing_ || approx_.On()) //n-grams, the index and sketches need the files in order: read them all on this thread
+        numWorkers = 0;
+    std::thread * workers = new(std::nothrow) std::thread [numWorkers];
+    if (q.jobs == nullptr || workers == nullptr)
+    {
+        std::cerr << "** WordSmith memory allocation failure\n";
+        delete [] q.jobs;
+        delete [] workers;
+        return 0;
+    }
+    q.size = numFiles;
+    q.next = 0;
+    q.grams = Grams();
+    q.index = Index();
+    q.file = (uint32_t)infiles_.Size();
+    q.approx = approx_.On() ? &approx_ : nullptr;
+    q.topk = Tracking();
+    size_t i = 0;
+    for (fsu::List<fsu::String>::ConstIterator f = infiles.Begin(); f != infiles.End(); ++f, ++i)
+    {
+        q.jobs[i].name = *f;
+        q.jobs[i].words = q.jobs[i].newWords = 0;
+        q.jobs[i].opened = q.jobs[i].error = q.jobs[i].done = 0;
+    }
+    
+    size_t started = 0;
+    for (size_t w = 0; w < numWorkers; ++w)
+    {
+        try
+        {
+            workers[w] = std::thread(CountFiles, &q);
+            ++started;
+        }
+        catch (const std::system_error&) //run with the workers there are
+        {}
+    }
+    if (started == 0) //no threads at all: read the files here
+        CountFiles(&q);
+    
+    //merge and report in list order while later files are still being read
+    size_t numRead = 0;
+    AddCounts<SetType,TopKType> add(frequency_, Tracking());
+    for (i = 0; i < numFiles; ++i)
+    {
+        FileJob& job = q.jobs[i];
+        {
+            std::unique_lock<std::mutex> g(q.lock);
+            while (!job.done)
+                q.finished.wait(g);
+        }
+        if (!job.opened)
+        {
+            std::cout << "    ** Cannot open file " << job.name << '\n';
+            continue;
+        }
+        size_t initVocabSize = VocabSize();
+        if (q.approx != nullptr) //already counted, every file: report the share taken as it was read
+            initVocabSize = initVocabSize > job.newWords ? initVocabSize - job.newWords : 0;
+        job.frequency.Traverse(add); //keys in order
+        job.frequency.Clear();
+        if (job.error)
+            std::cerr << "** WordSmith read error in " << job.name << "\n";
+        if (showProgress)
+            std::cout << "  ** reading progress : file " << i + 1 << " of " << numFiles << ", " << job.name << "\n";
+        EndRead(job.name, job.words, initVocabSize);
+        ++numRead;
+    }
+    
+    for (size_t w = 0; w < numWorkers; ++w)
+    {
+        if (workers[w].joinable())
+            workers[w].join();
+    }
+    delete [] workers;
+    delete [] q.jobs;
+    return numRead;
+}
+
+template < class C >
+size_t WordSmith::CountWords (fsu::TextSource& source, C& frequency, fsu::ReadProgress* progress, TopKType* topk,
+                              fsu::NGramCounter* grams, fsu::Postings* index, SpillRuns* spill)
+{
+    size_t wordCounter = 0;
+    size_t newWords = 0; //counted for the first time
+    
+    KeyScratch keys;
+    size_t cleanedSize = 256;
+    char * cleaned = new(std::nothrow) char [cleanedSize]; //cleaned word; grows with the longest word
+    const char * word;
+    size_t length;
+    unsigned kind;
+    
+    while (cleaned != nullptr && source.Next(word, length, kind)) //words separated by whitespace, until EOF
+    {
+        const char * clean = cleaned;
+        size_t n = length;
+        if (kind == 0) //lowercase letters and digits only: cleanup would keep the word as it is
+            clean = word;
+        else
         {
-            if (wordCounter % tickerVal == 0) //if the read word count is a multiple of the ticker value
+            if (length > cleanedSize) //cleanup never lengthens a word
             {
-                std::cout << "  ** reading progress : numwords == " << wordCounter << "\n";
+                delete [] cleaned;
+                while (cleanedSize < length) cleanedSize *= 2;
+                cleaned = new(std::nothrow) char [cleanedSize];
+                if (cleaned == nullptr)
+                    break;
+                clean = cleaned;
             }
+            if (kind == fsu::TextScan::UPPER) //letters and digits: cleanup would only lowercase it
+                fsu::TextScan::Lower(word, length, cleaned);
+            else
+                n = WordSmith::Cleanup(word, length, cleaned); //cleans up the word as per rules
         }
         
+        if (n != 0) //if cleanup operation resulted in non-zero length string
+        {
+            const KeyType& key = keys.Make(clean, n);
+            DataType count = Tally(frequency, key); //creates the key if new; increments its count
+            if (topk != nullptr)
+                topk->Update(key, count);
+            if (grams != nullptr)
+                grams->Add(key);
+            if (index != nullptr)
+                index->Add(key);
+            ++wordCounter;                    //increment the word Counter for this read
+            newWords += (count == 1);
+            if (spill != nullptr && count == 1 && spill->Full(n + 1)) //the new word took the table past the limit
+                spill->Write(frequency);
+        }
+        
+        if (progress != nullptr && --progress->ticks == 0) //a look at the clock every so many tokens
+            progress->Check(source.Offset(), wordCounter, newWords);
+        
     } // end reading file
     
-    count_ += wordCounter; //add to count_ var
+    if (progress != nullptr)
+        progress->Add(source.Offset(), wordCounter, newWords);
     
-    std::cout << "\n\tNumber of words read:    " << wordCounter;
+    if (cleaned == nullptr)
+        std::cerr << "** WordSmith memory allocation failure\n";
+    delete [] cleaned;
+    return wordCounter;
+}
+
+size_t WordSmith::Count (fsu::TextSource& source, fsu::ReadProgress* progress)
+{
+    if (approx_.On())
+        return CountWords(source, approx_, progress, Tracking(), Grams(), Index());
+    spill_.Start(frequency_.EntryBytes());
+    return CountWords(source, frequency_, progress, Tracking(), Grams(), Index(), Spill());
+}
+
+void WordSmith::StartProgress (fsu::ReadProgress& progress, size_t vocabSize) const
+{
+    progress.vocabBefore = vocabSize;
+    if (approx_.On()) //the sketches do not grow
+        progress.fixedBytes = approx_.Counts().Memory() + approx_.Distincts().Memory();
+    else if (spill_.On()) //the table stays within the limit
+        progress.fixedBytes = spill_.Limit();
+    else
+        progress.entryBytes = frequency_.EntryBytes();
+}
+
+void WordSmith::CountChunk (Chunk* c)
+{
+    fsu::TextSource source;
+    source.Open(c->begin, c->end);
+    c->words = CountWords(source, c->frequency, nullptr);
+}
+
+size_t WordSmith::ReadParallel (const fsu::TextSource& source, size_t threads, bool showProgress)
+{
+    Chunk * chunks = new(std::nothrow) Chunk [threads];
+    std::thread * workers = new(std::nothrow) std::thread [threads];
+    if (chunks == nullptr || workers == nullptr)
+    {
+        std::cerr << "** WordSmith memory allocation failure\n";
+        delete [] chunks;
+        delete [] workers;
+        fsu::TextSource whole;
+        whole.Open(source.Data(), source.Data() + source.Size());
+        fsu::ReadProgress progress(std::cout, source.Size());
+        if (showProgress)
+            StartProgress(progress, VocabSize());
+        return CountWords(whole, frequency_, showProgress ? &progress : nullptr, Tracking());
+    }
     
-    std::cout << "\n\tNew words in vocabulary: " << VocabSize() - initVocabSize << "\n";
+    //chunk i ends just after the first word break at or past i/threads of the file
+    const char * data = source.Data(), * end = data + source.Size();
+    const char * begin = data;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        const char * cut = (i + 1 == threads) ? end : data + (source.Size() / threads) * (i + 1);
+        if (cut < begin) cut = begin;
+        while (cut < end && !fsu::TextSource::IsBreak(*cut)) ++cut;
+        if (cut < end) ++cut;
+        chunks[i].begin = begin;
+        chunks[i].end = cut;
+        chunks[i].words = 0;
+        begin = cut;
+    }
     
-    infiles_.PushBack(infile); //pushes the file name to the infiles_ list
+    for (size_t i = 1; i < threads; ++i) //chunk 0 is read on this thread
+    {
+        try
+        {
+            workers[i] = std::thread(CountChunk, chunks + i);
+        }
+        catch (const std::system_error&) //no thread to be had: read the chunk when it is merged
+        {}
+    }
+    CountChunk(chunks);
     
-    return 1; //operation was successful
+    size_t wordCounter = 0;
+    AddCounts<SetType,TopKType> add(frequency_, Tracking());
+    for (size_t i = 0; i < threads; ++i)
+    {
+        if (workers[i].joinable())
+            workers[i].join();
+        else if (i > 0)
+            CountChunk(chunks + i);
+        chunks[i].frequency.Traverse(add); //keys in order
+        chunks[i].frequency.Clear();
+        wordCounter += chunks[i].words;
+        if (showProgress)
+            std::cout << "  ** reading progress : chunk " << i + 1 << " of " << threads
+                      << ", numwords == " << wordCounter << "\n";
+    }
+    
+    delete [] chunks;
+    delete [] workers;
+    return wordCounter;
 }
 
+void WordSmith::TrackTopK (size_t k)
+{
+    if (approx_.On()) //the heavy hitters cannot be ranked again without the words
+        return;
+    if (spill_.On() || Spilled()) //counts in the table start over after each run
+        return;
+    if (!topk_.Reset(k))
+        return;
+    if (k > 0)
+        frequency_.ForEach(OfferCounts<TopKType>(topk_, 1)); //the words read so far
+}
+
+bool WordSmith::SetNGrams (size_t n, size_t megabytes)
+{
+    return grams_.SetOrder(n, megabytes << 20);
+}
+
+void WordSmith::SetIndexing (bool on)
+{
+    if (!on)
+        index_.Clear();
+    indexing_ = on;
+}
+
+bool WordSmith::SetApproximate (size_t megabytes, size_t k)
+{
+    if (megabytes == 0) //exact counting, from no data: the words are gone
+    {
+        if (!approx_.On())
+            return 1;
+        approx_.Reset(0);
+        ClearData();
+        count_ = 0;
+        TrackTopK(0);
+        return 1;
+    }
+    if (k == 0)
+        return 0;
+    bool wasOn = approx_.On();
+    if (!approx_.Reset(megabytes << 20))
+    {
+        approx_.Reset(0);
+        if (wasOn) //the old sketches are gone too
+        {
+            ClearData();
+            count_ = 0;
+            TrackTopK(0);
+        }
+        return 0;
+    }
+    if (wasOn) //new sketch sizes: start over
+    {
+        ClearData();
+        count_ = 0;
+        topk_.Reset(k);
+        return 1;
+    }
+    //fold the exact counts in: rank the words first, while they are still there
+    topk_.Reset(k);
+    if (Spilled()) //the words on disk too
+    {
+        if (!MergeCounts(OfferCounts<TopKType>(topk_, 1)) || !MergeCounts(FoldCounts<ApproxCounts>(approx_)))
+        {
+            approx_.Reset(0); //still exact, with the runs as they were
+            topk_.Reset(0);
+            return 0;
+        }
+    }
+    else
+    {
+        frequency_.ForEach(OfferCounts<TopKType>(topk_, 1));
+        frequency_.ForEach(FoldCounts<ApproxCounts>(approx_));
+    }
+    frequency_.Clear();
+    spill_.Clear(); //the sketches are the limit now
+    spill_.SetLimit(0);
+    return 1;
+}
+
+bool WordSmith::SetMemoryLimit (size_t megabytes)
+{
+    if (approx_.On()) //the sketches are fixed in size already
+    {
+        if (megabytes > 0)
+            std::cerr << "** WordSmith: approximate counts are already within a fixed memory\n";
+        return megabytes == 0;
+    }
+    if (megabytes == 0)
+    {
+        if (Spilled()) //read the runs back into the emptied table
+        {
+            if (!spill_.Write(frequency_))
+                return 0;
+            fsu::RunMerger merger;
+            KeyType word;
+            unsigned long long count;
+            bool ok = merger.Open(spill_.Files(), spill_.MergeBuffer());
+            while (ok && merger.Next(word, count))
+                frequency_[word] = (DataType)count;
+            if (!ok || merger.Error()) //every word is still in the runs: keep them, and only them
+            {
+                frequency_.Clear();
+                std::cerr << "** WordSmith could not read back the spilled words; they stay on disk\n";
+                return 0;
+            }
+            spill_.Clear();
+        }
+        spill_.SetLimit(0);
+        return 1;
+    }
+    topk_.Reset(0); //counts in the table will start over after each run
+    size_t held = 0;
+    frequency_.ForEach(KeyBytes(held));
+    spill_.SetLimit(megabytes << 20);
+    spill_.Hold(held + frequency_.Size() * frequency_.EntryBytes()); //spilled at the next new word if over
+    return 1;
+}
+
+template < class C >
+bool WordSmith::SpillRuns::Write (C& frequency)
+{
+    fsu::RunWriter run;
+    bool ok = run.Open();
+    if (ok)
+    {
+        frequency.ForEach(PutCounts<fsu::RunWriter>(run)); //report order
+        ok = run.Close();
+    }
+    if (!ok) //keep the words in memory
+    {
+        std::cerr << "** WordSmith cannot spill words to disk; the memory limit is off\n";
+        limit_ = 0;
+        return 0;
+    }
+    files_.PushBack(run.Path());
+    frequency.Clear();
+    held_ = 0;
+    vocabKnown_ = 0;
+    if (files_.Size() > fsu::RunMerger::FanIn()) //keep one merge of them all possible
+        Compact();
+    return 1;
+}
+
+bool WordSmith::SpillRuns::Compact ()
+{
+    fsu::RunMerger merger;
+    fsu::RunWriter run;
+    KeyType word;
+    unsigned long long count;
+    bool ok = merger.Open(files_, MergeBuffer()) && run.Open();
+    while (ok && merger.Next(word, count))
+        run.Put(word, count);
+    ok = ok && !merger.Error();
+    bool written = run.Close();
+    if (!ok || !written)
+    {
+        if (written)
+            std::remove(run.Path().Cstr());
+        std::cerr << "** WordSmith could not merge the spilled runs; they are kept as they are\n";
+        return 0;
+    }
+    for (ListType::ConstIterator i = files_.Begin(); i != files_.End(); ++i)
+        std::remove((*i).Cstr());
+    files_.Clear();
+    files_.PushBack(run.Path());
+    return 1;
+}
+
+size_t WordSmith::SpillRuns::MergeBuffer () const
+{
+    const size_t least = 1 << 12, most = 1 << 18;
+    if (limit_ == 0)
+        return most;
+    size_t b = limit_ / fsu::RunMerger::FanIn(); //the buffers of a merge fit in the limit
+    return b < least ? least : (b > most ? most : b);
+}
+
+void WordSmith::SpillRuns::Clear ()
+{
+    for (ListType::ConstIterator i = files_.Begin(); i != files_.End(); ++i)
+        std::remove((*i).Cstr());
+    files_.Clear();
+    held_ = 0;
+    vocabKnown_ = 0;
+}
+
+bool WordSmith::ApproxCounts::Reset (size_t budget)
+{
+    if (budget == 0)
+    {
+        counts_.Reset(0, 0);
+        distinct_.Reset(0);
+        return 1;
+    }
+    if (!distinct_.Reset(14)) //16 KB, standard error 0.81%
+        return 0;
+    if (!counts_.Reset(budget > ((size_t)1 << 14) ? budget - ((size_t)1 << 14) : 0))
+    {
+        distinct_.Reset(0);
+        return 0;
+    }
+    return 1;
+}
+
+WordSmith::DataType WordSmith::ApproxCounts::Add (const KeyType& key, DataType n)
+{
+    unsigned long long h = fsu::Mix(hash_(key));
+    distinct_.Add(h);
+    return (DataType)counts_.Add(h, n);
+}
+
+void WordSmith::SetThreads (size_t n)
+{
+    if (n == 0)
+        n = std::thread::hardware_concurrency(); //0 if unknown
+    threads_ = (n > 0) ? n : 1;
+}
+
+const fsu::String& WordSmith::KeyScratch::Make (const char* word, size_t n)
+{
+    fsu::String& key = (n < MaxKey) ? keys_[n] : long_;
+    if (key.Size() != n)
+        key.SetSize(n);
+    for (size_t i = 0; i < n; ++i)
+        key[i] = word[i];
+    return key;
+}
+
+// writes report rows as Display() does: through tb if given (the stream prints plain decimal),
+// else through the stream
+template < class K , class D >
+class WriteRows
+{
+public:
+    WriteRows (std::ostream& os, fsu::TextBuffer* tb, int kw, int dw, std::ios_base::fmtflags kf, std::ios_base::fmtflags df)
+        : os_(os), tb_(tb), kw_(kw), dw_(dw), kf_(kf), df_(df), fill_(os.fill()) {}
+    void operator() (const K& key, const D& count) const
+    {
+        if (tb_ == nullptr)
+        {
+            os_.setf(kf_, std::ios_base::adjustfield);
+            os_ << std::setw(kw_) << key;
+            os_.setf(df_, std::ios_base::adjustfield);
+            os_ << std::setw(dw_) << count << '\n';
+            return;
+        }
+        char scratch[fsu::TextFormat<D>::Size];
+        size_t n;
+        const char * text = fsu::TextFormat<K>::Text(key, scratch, n);
+        if (text != nullptr) //else << prints nothing, not even padding
+            tb_->Field(text, n, kw_, kf_, fill_, 0);
+        text = fsu::TextFormat<D>::Text(count, scratch, n);
+        tb_->Field(text, n, dw_, df_, fill_, 1);
+        tb_->Put('\n');
+    }
+private:
+    std::ostream&           os_;
+    fsu::TextBuffer *       tb_;
+    int                     kw_, dw_;
+    std::ios_base::fmtflags kf_, df_;
+    char                    fill_;
+};
+
 bool WordSmith::WriteReport (const fsu::String& outfile, unsigned short kw, unsigned short dw,
                              std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
 {
+    if (approx_.On())
+    {
+        std::cout << "\n Approximate counts keep no word list, leaving " << outfile << " unopened\n";
+        return 1;
+    }
+    
     const char * fileForWrite = outfile.Cstr();
     std::ofstream outClientFile(fileForWrite, std::ios::out); //opens file for output
     
@@ -88,14 +818,7 @@ bool WordSmith::WriteReport (const fsu::String& outfile, unsigned short kw, unsi
     outClientFile.seekp(0); //ensure the pointer is at the beginning of the file
     
     outClientFile << "Text Analysis for files: ";
-    
-    ListType::ConstIterator i; //declare itatator for list
-    for (i = infiles_.Begin(); i != infiles_.End(); ++i)
-    {
-        outClientFile << *i;
-        if (i != infiles_.rBegin()) //if the iterator is not on the last file
-            outClientFile << ", "; //comma space
-    }
+    WriteFileList(outClientFile);
     
     outClientFile << "\n\n";
     
@@ -108,7 +831,24 @@ bool WordSmith::WriteReport (const fsu::String& outfile, unsigned short kw, unsi
     outClientFile << "\n";
     
     //loop through all words
-    frequency_.Display(outClientFile, kw, dw, kf, df); //use OAA's display method to write to file
+    if (Spilled()) //merge the runs with the table, straight into the file
+    {
+        bool merged;
+        {
+            fsu::TextBuffer tb(outClientFile);
+            merged = MergeCounts(WriteRows<KeyType,DataType>(outClientFile, fsu::PlainDecimal(outClientFile) ? &tb : nullptr,
+                                                             kw, dw, kf, df));
+        }
+        if (!merged) //leave no partial report
+        {
+            outClientFile.close();
+            std::remove(fileForWrite);
+            std::cout << "\n ** Spilled runs could not be merged, no report written to " << outfile << "\n";
+            return 1;
+        }
+    }
+    else
+        frequency_.Display(outClientFile, kw, dw, kf, df); //use OAA's display method to write to file
     
     //create temp vars to avoid multiple calls
     size_t numWords = WordsRead();
@@ -131,36 +871,789 @@ bool WordSmith::WriteReport (const fsu::String& outfile, unsigned short kw, unsi
     return 1; //file written successfully
 }
 
-void WordSmith::ShowSummary () const
+// collects the rows of a frequency report, in report order
+template < class R , class D >
+class CollectRows
 {
-    std::cout << "\nCurrent files:           ";
-    ListType::ConstIterator i; //declare itatator for list
-    for (i = infiles_.Begin(); i != infiles_.End(); ++i)
+public:
+    CollectRows (R* rows, size_t& n, D& maxCount) : rows_(rows), n_(n), max_(maxCount) {}
+    template < class K >
+    void operator() (const K& key, const D& count) const
     {
-        std::cout << *i;
-        if (i != infiles_.rBegin()) //if the iterator is not on the last file
-            std::cout << ", "; //comma space
+        rows_[n_].key = &key;
+        rows_[n_].count = count;
+        ++n_;
+        if (count > max_)
+            max_ = count;
     }
-    std::cout << "\nCurrent word count:      ";
-    std::cout << WordsRead();
-    std::cout << "\nCurrent vocabulary size: ";
-    std::cout << VocabSize();
-    std::cout << "\n\n";
-}
-
-void WordSmith::ClearData ()  //temporarily using as debugger
-{
-    frequency_.Clear(); //empty the data
-    infiles_.Clear(); //empty the list of file names
-}
+private:
+    R*      rows_;
+    size_t& n_;
+    D&      max_;
+};
 
-size_t WordSmith::WordsRead() const
+template < class F >
+bool WordSmith::MergeCounts (F f) const
 {
-    return count_;
+    //the table's rows in report order, then a two-way merge of them with the merged runs
+    size_t n = frequency_.Size(), numRows = 0;
+    Row * rows = new(std::nothrow) Row [n > 0 ? n : 1];
+    DataType maxCount = 0;
+    if (rows == nullptr)
+    {
+        std::cerr << "** WordSmith memory allocation failure\n";
+        return 0;
+    }
+    frequency_.ForEach(CollectRows<Row,DataType>(rows, numRows, maxCount));
+    
+    fsu::RunMerger merger;
+    bool ok = merger.Open(spill_.Files(), spill_.MergeBuffer());
+    if (!ok)
+    {
+        delete [] rows;
+        std::cerr << "** WordSmith could not read every spilled word\n";
+        return 0;
+    }
+    KeyType word;
+    unsigned long long count = 0;
+    bool more = ok && merger.Next(word, count);
+    size_t r = 0, vocab = 0;
+    while (more || r < numRows)
+    {
+        if (r < numRows && (!more || *rows[r].key < word))
+        {
+            f(*rows[r].key, rows[r].count);
+            ++r;
+        }
+        else
+        {
+            DataType c = (DataType)count;
+            if (r < numRows && !(word < *rows[r].key)) //in both
+                c += rows[r++].count;
+            f(word, c);
+            more = merger.Next(word, count);
+        }
+        ++vocab;
+    }
+    delete [] rows;
+    ok = ok && !merger.Error();
+    if (ok)
+        spill_.SetVocab(vocab);
+    else
+        std::cerr << "** WordSmith could not read every spilled word\n";
+    return ok;
 }
 
-size_t WordSmith::VocabSize() const
+bool WordSmith::SortByFrequency (Row*& rows, size_t n, DataType maxCount)
 {
+    //one counting pass on maxCount - count when the counts array is no bigger than the rows;
+    //otherwise 16-bit digits of it, least significant first. Every pass is stable, so words
+    //of equal frequency keep their report order.
+    const size_t digitBits = 16, maxRadix = (size_t)1 << digitBits;
+    bool onePass = maxCount < ((n > maxRadix) ? n : maxRadix);
+    size_t radix = onePass ? maxCount + 1 : maxRadix;
+    size_t mask = onePass ? ~(size_t)0 : maxRadix - 1;
+    size_t passes = 1;
+    while (!onePass && passes * digitBits < 8 * sizeof(DataType) && (maxCount >> (passes * digitBits)) != 0)
+        ++passes;
+    Row * out = new(std::nothrow) Row [n > 0 ? n : 1];
+    size_t * start = new(std::nothrow) size_t [radix];
+    if (out == nullptr || start == nullptr)
+    {
+        delete [] out;
+        delete [] start;
+        return 0;
+    }
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        size_t shift = pass * digitBits;
+        for (size_t d = 0; d < radix; ++d)
+            start[d] = 0;
+        for (size_t i = 0; i < n; ++i)
+            ++start[((maxCount - rows[i].count) >> shift) & mask];
+        size_t sum = 0;
+        for (size_t d = 0; d < radix; ++d)
+        {
+            size_t c = start[d];
+            start[d] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; ++i)
+            out[start[((maxCount - rows[i].count) >> shift) & mask]++] = rows[i];
+        Row * t = rows;
+        rows = out;
+        out = t;
+    }
+    delete [] out;
+    delete [] start;
+    return 1;
+}
+
+bool WordSmith::WriteFrequencyReport (const fsu::String& outfile, unsigned short kw, unsigned short dw,
+                                      std::ios_base::fmtflags kf, std::ios_base::fmtflags df) const
+{
+    if (approx_.On())
+    {
+        std::cout << "\n Approximate counts keep no word list, leaving " << outfile << " unopened\n";
+        return 1;
+    }
+    if (Spilled()) //every row would be in memory at once
+    {
+        std::cout << "\n Words spilled to disk are reported by word or top k only, leaving " << outfile << " unopened\n";
+        return 1;
+    }
+    
+    std::ofstream outClientFile(outfile.Cstr(), std::ios::out); //opens file for output
+    
+    if (!outClientFile)
+    {
+        return 0; //error - file could not be written
+    }
+    
+    if (infiles_.Empty())
+    {
+        std::cout << "\n No files in read list, leaving " << outfile << " unopened\n";
+        outClientFile.close();
+        return 1;
+    }
+    
+    size_t vocabSize = VocabSize();
+    Row * rows = new(std::nothrow) Row [vocabSize > 0 ? vocabSize : 1];
+    size_t numRows = 0;
+    DataType maxCount = 0;
+    if (rows != nullptr)
+    {
+        frequency_.ForEach(CollectRows<Row,DataType>(rows, numRows, maxCount)); //report order
+        if (!SortByFrequency(rows, numRows, maxCount))
+        {
+            delete [] rows;
+            rows = nullptr;
+        }
+    }
+    if (rows == nullptr) //a report without its rows would pass for a complete one
+    {
+        std::cerr << "** WordSmith memory allocation failure\n";
+        outClientFile.close();
+        std::remove(outfile.Cstr());
+        return 0;
+    }
+    
+    outClientFile << "Text Analysis for files: ";
+    WriteFileList(outClientFile);
+    
+    outClientFile << "\n\n";
+    outClientFile << "Words by frequency\n\n";
+    
+    outClientFile << std::setw(kw) << std::left << "word";
+    outClientFile << std::setw(dw) << std::right << "frequency";
+    outClientFile << "\n";
+    outClientFile << std::setw(kw) << std::left << "----";
+    outClientFile << std::setw(dw) << std::right << "---------";
+    outClientFile << "\n";
+    
+    if (fsu::PlainDecimal(outClientFile)) //same bytes as the stream would write, in large chunks
+    {
+        fsu::TextBuffer tb(outClientFile);
+        char fill = outClientFile.fill();
+        char scratch[fsu::TextFormat<DataType>::Size];
+        for (size_t r = 0; r < numRows; ++r)
+        {
+            size_t n;
+            const char * text = fsu::TextFormat<KeyType>::Text(*rows[r].key, scratch, n);
+            if (text != nullptr) //else << prints nothing, not even padding
+                tb.Field(text, n, kw, kf, fill, 0);
+            text = fsu::TextFormat<DataType>::Text(rows[r].count, scratch, n);
+            tb.Field(text, n, dw, df, fill, 1);
+            tb.Put('\n');
+        }
+    }
+    else
+    {
+        for (size_t r = 0; r < numRows; ++r)
+        {
+            outClientFile.setf(kf, std::ios_base::adjustfield);
+            outClientFile << std::setw(kw) << *rows[r].key;
+            outClientFile.setf(df, std::ios_base::adjustfield);
+            outClientFile << std::setw(dw) << rows[r].count << '\n';
+        }
+    }
+    delete [] rows;
+    
+    size_t numWords = WordsRead();
+    
+    outClientFile << "\n";
+    outClientFile << "Number of words: " << numWords << "\n";
+    outClientFile << "Vocabulary size: " << vocabSize << "\n";
+    
+    outClientFile.close(); //close the file
+    
+    std::cout << "\n\tNumber of words:         " << numWords << "\n";
+    std::cout << "\tVocabulary size:         " << vocabSize << "\n";
+    std::cout << "\tAnalysis by frequency written to file ";
+    std::cout << outfile;
+    std::cout << "\n\n";
+    
+    return 1; //file written successfully
+}
+
+bool WordSmith::WriteTopK (size_t k, const fsu::String& outfile, unsigned short kw, unsigned short dw) const
+{
+    std::ofstream outClientFile(outfile.Cstr(), std::ios::out); //opens file for output
+    
+    if (!outClientFile)
+    {
+        return 0; //error - file could not be written
+    }
+    
+    if (infiles_.Empty())
+    {
+        std::cout << "\n No files in read list, leaving " << outfile << " unopened\n";
+        outClientFile.close();
+        return 1;
+    }
+    
+    if (!Spilled() && k > VocabSize()) //spilled words are counted by the merge below
+        k = VocabSize();
+    if (approx_.On() && k > topk_.Capacity()) //only the heavy hitters are known
+        k = topk_.Capacity();
+    
+    //the tracked heap already holds the answer if it is at least k deep; otherwise make one pass
+    TopKType scratch;
+    const TopKType * top = &topk_;
+    if (k > topk_.Capacity())
+    {
+        top = &scratch;
+        if (scratch.Reset(k) && Spilled())
+        {
+            if (!MergeCounts(OfferCounts<TopKType>(scratch, 0))) //leave no partial report
+            {
+                outClientFile.close();
+                std::remove(outfile.Cstr());
+                std::cout << "\n ** Spilled runs could not be merged, no report written to " << outfile << "\n";
+                return 1;
+            }
+        }
+        else if (scratch.Capacity() > 0)
+            frequency_.ForEach(OfferCounts<TopKType>(scratch, 0));
+    }
+    
+    TopKType::Entry * rows = new(std::nothrow) TopKType::Entry [top->Size() > 0 ? top->Size() : 1];
+    size_t numRows = 0;
+    if (rows == nullptr)
+        std::cerr << "** WordSmith memory allocation failure\n";
+    else
+        numRows = top->Sorted(rows);
+    if (numRows > k)
+        numRows = k;
+    
+    outClientFile << "Text Analysis for files: ";
+    WriteFileList(outClientFile);
+    
+    outClientFile << "\n\n";
+    outClientFile << "Top " << numRows << " words by " << (approx_.On() ? "estimated " : "") << "frequency\n\n";
+    
+    outClientFile << std::setw(kw) << std::left << "word";
+    outClientFile << std::setw(dw) << std::right << "frequency";
+    outClientFile << "\n";
+    outClientFile << std::setw(kw) << std::left << "----";
+    outClientFile << std::setw(dw) << std::right << "---------";
+    outClientFile << "\n";
+    
+    for (size_t r = 0; r < numRows; ++r) //most frequent first
+    {
+        outClientFile << std::setw(kw) << std::left << rows[r].key;
+        outClientFile << std::setw(dw) << std::right << rows[r].data;
+        outClientFile << "\n";
+    }
+    delete [] rows;
+    
+    size_t numWords = WordsRead();
+    size_t vocabSize = VocabSize();
+    
+    outClientFile << "\n";
+    outClientFile << "Number of words: " << numWords << "\n";
+    outClientFile << "Vocabulary size: " << vocabSize << "\n";
+    WriteBounds(outClientFile);
+    
+    outClientFile.close(); //close the file
+    
+    std::cout << "\n\tNumber of words:         " << numWords << "\n";
+    std::cout << "\tVocabulary size:         " << vocabSize << "\n";
+    std::cout << "\tTop " << numRows << " words written to file ";
+    std::cout << outfile;
+    std::cout << "\n\n";
+    
+    return 1; //file written successfully
+}
+
+// writes an n-gram's words, separated by spaces and left justified in width
+static void WriteNGram (std::ostream& os, const fsu::NGram& g, const fsu::WordIds& words, size_t order, size_t width)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < order; ++i)
+    {
+        const fsu::String& w = words.Word(g.id[i]);
+        if (i > 0)
+            os << ' ';
+        os << w;
+        n += w.Size() + (i > 0);
+    }
+    for (; n < width; ++n)
+        os << ' ';
+}
+
+bool WordSmith::WriteNGramReport (size_t k, const fsu::String& outfile, unsigned short kw, unsigned short dw) const
+{
+    size_t order = grams_.Order();
+    if (order == 0)
+    {
+        std::cout << "\n Not counting n-grams, leaving " << outfile << " unopened\n";
+        return 1;
+    }
+    
+    std::ofstream outClientFile(outfile.Cstr(), std::ios::out); //opens file for output
+    
+    if (!outClientFile)
+    {
+        return 0; //error - file could not be written
+    }
+    
+    if (infiles_.Empty())
+    {
+        std::cout << "\n No files in read list, leaving " << outfile << " unopened\n";
+        outClientFile.close();
+        return 1;
+    }
+    
+    const fsu::NGramTable& table = grams_.Table();
+    const char * name = (order == 2) ? "bigram" : "trigram";
+    if (k > table.Size())
+        k = table.Size();
+    
+    //one pass over the table with a size-k heap; ties in alphabetical order of the words
+    typedef fsu::TopK <fsu::NGram,DataType,fsu::NGramOrder> NGramTopK;
+    NGramTopK top(fsu::NGramOrder(grams_.Words(), order));
+    NGramTopK::Entry * rows = nullptr;
+    size_t numRows = 0;
+    if (top.Reset(k))
+    {
+        table.ForEach(OfferCounts<NGramTopK>(top, 0));
+        rows = new(std::nothrow) NGramTopK::Entry [top.Size() > 0 ? top.Size() : 1];
+    }
+    if (rows == nullptr)
+        std::cerr << "** WordSmith memory allocation failure\n";
+    else
+        numRows = top.Sorted(rows);
+    
+    outClientFile << "Text Analysis for files: ";
+    WriteFileList(outClientFile);
+    
+    outClientFile << "\n\n";
+    outClientFile << "Top " << numRows << " " << name << "s by frequency\n\n";
+    
+    outClientFile << std::setw(kw) << std::left << name;
+    outClientFile << std::setw(dw) << std::right << "frequency";
+    outClientFile << "\n";
+    outClientFile << std::setw(kw) << std::left << fsu::String(fsu::String(name).Size(), '-');
+    outClientFile << std::setw(dw) << std::right << "---------";
+    outClientFile << "\n";
+    
+    for (size_t r = 0; r < numRows; ++r) //most frequent first
+    {
+        WriteNGram(outClientFile, rows[r].key, grams_.Words(), order, kw);
+        outClientFile << std::setw(dw) << std::right << rows[r].data;
+        outClientFile << "\n";
+    }
+    delete [] rows;
+    
+    outClientFile << "\n";
+    outClientFile << "Number of " << name << "s: " << table.Total() << "\n";
+    outClientFile << "Distinct " << name << "s kept: " << table.Size() << "\n";
+    if (table.Dropped() > 0)
+    {
+        outClientFile << "Dropped to stay within memory: " << table.Dropped() << " occurrences of "
+                      << name << "s seen at most " << table.Floor() << " times each\n";
+        outClientFile << "Counts above may be low by up to " << table.Floor() << "\n";
+    }
+    
+    outClientFile.close(); //close the file
+    
+    std::cout << "\n\tNumber of " << name << "s: " << table.Total() << "\n";
+    std::cout << "\tDistinct " << name << "s kept: " << table.Size() << "\n";
+    std::cout << "\tTop " << numRows << " " << name << "s written to file ";
+    std::cout << outfile;
+    std::cout << "\n\n";
+    
+    return 1; //file written successfully
+}
+
+// SaveState / LoadState file layout: the magic "WSSTATE1", then varints (LEB128, serial.h) for
+// the word count, the number of files and each name's length before its bytes, and the number
+// of words. Words follow in report order, front-coded: the length of the prefix shared with the
+// word before, the length and bytes of the rest, and the count. A 4-byte FNV-1a checksum of
+// everything before it ends the file.
+static const char stateMagic[] = "WSSTATE1"; //8 bytes, not counting the '\0'
+
+static uint32_t StateSum (const char* p, size_t n, uint32_t h = 2166136261u) //FNV-1a
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        h ^= (unsigned char)p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+class WordSmith::StateWriter
+{
+public:
+    StateWriter (std::ofstream& os, fsu::ByteBuffer& buf, uint32_t& sum, bool& ok)
+        : os_(os), buf_(buf), sum_(sum), ok_(ok), prev_(nullptr) {}
+    void operator() (const KeyType& key, const DataType& count)
+    {
+        if (!ok_)
+            return;
+        const char * k = key.Cstr();
+        size_t n = key.Size(), shared = 0;
+        if (prev_ != nullptr) //keys come in order: prev_ is the word before
+        {
+            const char * q = prev_->Cstr();
+            size_t m = prev_->Size();
+            while (shared < n && shared < m && k[shared] == q[shared]) ++shared;
+        }
+        ok_ = buf_.PutVarint(shared) && buf_.PutVarint(n - shared) && buf_.Put(k + shared, n - shared)
+              && buf_.PutVarint(count);
+        prev_ = &key;
+        if (ok_ && buf_.Size() >= 65536)
+            ok_ = Flush();
+    }
+    bool Flush () //writes the buffer out
+    {
+        sum_ = StateSum(buf_.Data(), buf_.Size(), sum_);
+        os_.write(buf_.Data(), buf_.Size());
+        buf_.Clear();
+        return os_.good();
+    }
+private:
+    std::ofstream&    os_;
+    fsu::ByteBuffer&  buf_;
+    uint32_t&         sum_;
+    bool&             ok_;
+    const KeyType *   prev_;
+};
+
+class WordSmith::StateReader
+{
+public:
+    StateReader (const char* p, const char* end) : p_(p), end_(end), word_() {}
+    bool operator() (KeyType& key, DataType& count) //the next word; false if the data runs out
+    {
+        unsigned long long shared, rest, c;
+        if (!fsu::GetVarint(p_, end_, shared) || !fsu::GetVarint(p_, end_, rest)
+            || shared > word_.Size() || rest > (unsigned long long)(end_ - p_) || shared + rest == 0)
+            return 0;
+        word_.Shrink((size_t)shared);
+        if (!word_.Put(p_, (size_t)rest))
+            return 0;
+        p_ += rest;
+        if (!fsu::GetVarint(p_, end_, c))
+            return 0;
+        size_t n = word_.Size();
+        if (key.Size() != n && !key.SetSize(n))
+            return 0;
+        for (size_t i = 0; i < n; ++i)
+            key[i] = word_.Data()[i];
+        count = (DataType)c;
+        return 1;
+    }
+    const char* Position () const { return p_; }
+private:
+    const char *     p_, * end_;
+    fsu::ByteBuffer  word_; //the word before, then this one
+};
+
+bool WordSmith::SaveState (const fsu::String& statefile) const
+{
+    if (approx_.On())
+    {
+        std::cerr << "** WordSmith: approximate counts cannot be saved\n";
+        return 0;
+    }
+    if (Spilled())
+    {
+        std::cerr << "** WordSmith: words spilled to disk cannot be saved; write a report instead\n";
+        return 0;
+    }
+    fsu::String tmpfile = statefile + fsu::String(".tmp");
+    std::ofstream os(tmpfile.Cstr(), std::ios::out | std::ios::binary);
+    if (!os)
+    {
+        return 0; //error - file could not be written
+    }
+    
+    fsu::ByteBuffer buf;
+    uint32_t sum = 2166136261u;
+    bool ok = buf.Put(stateMagic, 8) && buf.PutVarint(count_) && buf.PutVarint(infiles_.Size());
+    for (ListType::ConstIterator i = infiles_.Begin(); ok && i != infiles_.End(); ++i)
+        ok = fsu::Serial<fsu::String>::Write(buf, *i);
+    ok = ok && buf.PutVarint(VocabSize());
+    StateWriter writer(os, buf, sum, ok);
+    frequency_.ForEach(writer); //report order
+    ok = ok && writer.Flush() && os.write((const char*)&sum, 4).good();
+    os.close();
+    
+    if (!ok || os.fail() || std::rename(tmpfile.Cstr(), statefile.Cstr()) != 0)
+    {
+        std::remove(tmpfile.Cstr());
+        std::cerr << "** WordSmith cannot write state file " << statefile << "\n";
+        return 0;
+    }
+    
+    std::cout << "\n\tNumber of words:         " << WordsRead() << "\n";
+    std::cout << "\tVocabulary size:         " << VocabSize() << "\n";
+    std::cout << "\tState saved to file " << statefile << "\n\n";
+    return 1;
+}
+
+bool WordSmith::LoadState (const fsu::String& statefile)
+{
+    if (approx_.On())
+    {
+        std::cerr << "** WordSmith: switch to exact counting to load a state file\n";
+        return 0;
+    }
+    std::ifstream is(statefile.Cstr(), std::ios::in | std::ios::binary);
+    if (!is)
+    {
+        return 0; //error - file could not be read
+    }
+    is.seekg(0, std::ios::end);
+    std::streamoff size = is.tellg();
+    is.seekg(0, std::ios::beg);
+    char * data = (size > 0) ? new(std::nothrow) char [(size_t)size] : nullptr;
+    if (size > 0 && data == nullptr)
+    {
+        std::cerr << "** WordSmith memory allocation failure\n";
+        return 0;
+    }
+    bool ok = size >= 12 && is.read(data, size).good();
+    is.close();
+    
+    //check everything before touching the current data
+    const char * p = data, * end = data + (ok ? size - 4 : 0);
+    uint32_t sum = 0;
+    if (ok)
+        memcpy(&sum, end, 4);
+    ok = ok && memcmp(p, stateMagic, 8) == 0 && sum == StateSum(p, end - p);
+    p += 8;
+    unsigned long long words = 0, numFiles = 0, vocab = 0;
+    ok = ok && fsu::GetVarint(p, end, words) && fsu::GetVarint(p, end, numFiles);
+    ListType files;
+    fsu::String name;
+    for (unsigned long long f = 0; ok && f < numFiles; ++f)
+    {
+        ok = fsu::Serial<fsu::String>::Read(p, end, name);
+        if (ok)
+            files.PushBack(name);
+    }
+    ok = ok && fsu::GetVarint(p, end, vocab) && vocab <= (unsigned long long)(end - p) / 3; //3 bytes a word at least
+    if (!ok)
+    {
+        delete [] data;
+        std::cerr << "** WordSmith: " << statefile << " is not a WordSmith state file, or is damaged\n";
+        return 0;
+    }
+    
+    grams_.Clear(); //not in the file, and they would not match the loaded words
+    index_.Clear(); //nor would the index match the loaded file list
+    spill_.Clear(); //replaced by the loaded words
+    StateReader reader(p, end);
+    ok = frequency_.Build((size_t)vocab, reader) && reader.Position() == end && frequency_.Size() == vocab;
+    delete [] data;
+    if (!ok) //the checksum matched, but the words did not decode: start over empty
+    {
+        frequency_.Clear();
+        infiles_.Clear();
+        count_ = 0;
+        TrackTopK(TrackedTopK());
+        std::cerr << "** WordSmith: " << statefile << " holds bad words; current data erased\n";
+        return 1; //the file was read
+    }
+    infiles_ = files;
+    count_ = (size_t)words;
+    TrackTopK(TrackedTopK()); //rank the loaded words
+    if (spill_.On()) //spilled at the next new word if over the limit
+        SetMemoryLimit(MemoryLimit());
+    
+    std::cout << "\n\tNumber of words:         " << WordsRead() << "\n";
+    std::cout << "\tVocabulary size:         " << VocabSize() << "\n";
+    std::cout << "\tState loaded from file " << statefile << "\n\n";
+    return 1;
+}
+
+void WordSmith::ShowSummary () const
+{
+    std::cout << "\nCurrent files:           ";
+    WriteFileList(std::cout);
+    std::cout << "\nCurrent word count:      ";
+    std::cout << WordsRead();
+    std::cout << "\nCurrent vocabulary size: ";
+    size_t vocabSize = VocabSize();
+    if (Spilled() && !spill_.VocabKnown())
+        std::cout << "not known: the spilled runs could not be merged";
+    else
+        std::cout << vocabSize;
+    if (grams_.Order() > 0)
+    {
+        std::cout << (grams_.Order() == 2 ? "\nCurrent bigram count:    " : "\nCurrent trigram count:   ");
+        std::cout << grams_.Table().Total();
+    }
+    if (spill_.On() || Spilled())
+    {
+        std::cout << "\nMemory limit:            " << MemoryLimit() << " MB, "
+                  << spill_.Runs() << " run(s) on disk";
+    }
+    if (indexing_)
+    {
+        std::cout << "\nIndexed occurrences:     " << index_.Total()
+                  << " (" << (index_.Bytes() + (1 << 19)) / (1 << 20) << " MB)";
+    }
+    std::cout << "\n\n";
+    WriteBounds(std::cout);
+    if (approx_.On())
+        std::cout << "\n";
+}
+
+// writes, for each file holding both words, its name and how often each occurs there;
+// files come in increasing order, so the names are found by walking the file list once
+class WriteCommon
+{
+public:
+    typedef fsu::List < fsu::String > ListType;
+    WriteCommon (const ListType& files) : name_(files.Begin()), end_(files.End()), at_(0) {}
+    void operator() (uint32_t file, size_t countA, size_t countB)
+    {
+        for (; at_ < file && name_ != end_; ++at_)
+            ++name_;
+        if (name_ == end_)
+            return;
+        std::cout << "\t  " << std::setw(30) << std::left << *name_ << std::right
+                  << std::setw(10) << countA << std::setw(10) << countB << "\n";
+    }
+private:
+    ListType::ConstIterator name_, end_;
+    uint32_t                at_;
+};
+
+bool WordSmith::ShowOccurrences (fsu::String word) const
+{
+    if (!indexing_)
+        return 0;
+    Cleanup(word);
+    fsu::Postings::Cursor c;
+    size_t count;
+    if (!index_.Find(word, c, count))
+    {
+        std::cout << "\n\t" << word << " does not occur in the indexed files\n\n";
+        return 1;
+    }
+    std::cout << "\n\t" << word << " occurs " << count << " time(s), at word positions:\n";
+    
+    const size_t maxShown = 10; //positions listed per file
+    ListType::ConstIterator name = infiles_.Begin();
+    uint32_t at = 0; //the file name points to
+    uint32_t file;
+    unsigned long long pos;
+    bool more = c.Next(file, pos);
+    while (more)
+    {
+        uint32_t current = file;
+        for (; at < current && name != infiles_.End(); ++at)
+            ++name;
+        if (name == infiles_.End()) //cannot happen: files are listed as they are read
+            break;
+        std::cout << "\t  " << *name << ":";
+        size_t n = 0;
+        for (; more && file == current; more = c.Next(file, pos), ++n)
+        {
+            if (n < maxShown)
+                std::cout << ' ' << pos;
+        }
+        if (n > maxShown)
+            std::cout << " ...";
+        std::cout << "  (" << n << ")\n";
+    }
+    std::cout << "\n";
+    return 1;
+}
+
+bool WordSmith::ShowCommon (fsu::String a, fsu::String b) const
+{
+    if (!indexing_)
+        return 0;
+    Cleanup(a);
+    Cleanup(b);
+    std::cout << "\n\tFiles holding both " << a << " and " << b << ":\n";
+    std::cout << "\t  " << std::setw(30) << std::left << "file" << std::right
+              << std::setw(10) << a << std::setw(10) << b << "\n";
+    size_t files = index_.Intersect(a, b, WriteCommon(infiles_));
+    std::cout << "\t" << files << " file(s)\n\n";
+    return 1;
+}
+
+void WordSmith::ClearData ()  //temporarily using as debugger
+{
+    frequency_.Clear(); //empty the data
+    infiles_.Clear(); //empty the list of file names
+    topk_.Clear(); //still tracking, from no words
+    grams_.Clear(); //still counting n-grams, from no words
+    index_.Clear(); //still indexing, if it was, from the first file
+    spill_.Clear(); //still limited, if it was
+    approx_.Clear(); //still approximate, if it was
+}
+
+void WordSmith::WriteFileList (std::ostream& os) const
+{
+    ListType::ConstIterator i; //declare itatator for list
+    for (i = infiles_.Begin(); i != infiles_.End(); ++i)
+    {
+        os << *i;
+        if (i != infiles_.rBegin()) //if the iterator is not on the last file
+            os << ", "; //comma space
+    }
+}
+
+void WordSmith::WriteBounds (std::ostream& os) const
+{
+    if (!approx_.On())
+        return;
+    const fsu::CountMin& cm = approx_.Counts();
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision(2);
+    os.setf(std::ios_base::fixed, std::ios_base::floatfield);
+    os << "Approximate counts: " << (cm.Memory() + approx_.Distincts().Memory()) / 1024 << " KB of sketches\n";
+    os << "  word counts are never low, and are high by at most " << cm.Error()
+       << " with probability " << 100 * cm.Confidence() << "%\n";
+    os << "  vocabulary size has a standard error of " << 100 * approx_.Distincts().Error() << "%\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+size_t WordSmith::WordsRead() const
+{
+    return count_;
+}
+
+size_t WordSmith::VocabSize() const
+{
+    if (approx_.On())
+        return approx_.Distinct(); //HyperLogLog estimate
+    if (Spilled()) //the words of the runs and the table, each once
+    {
+        if (!spill_.VocabKnown() && !MergeCounts(CountKeys()))
+            return 0; //not known; VocabKnown() stays false
+        return spill_.Vocab();
+    }
     return frequency_.Size(); //returns size of wordset
 }
 
@@ -14,9 +14,15 @@
  all operations (except rehash) run in log n time.  Note - rehash would not be used
  with WordSmith.
  
+ SetType may instead be fsu::ART (art.h), an adaptive radix tree, or fsu::HashTable
+ (hashtable.h), an open-addressing hash table that sorts its keys only for a report.
+ 
  
  The API gives the ability to Read text from a file, write a report showing each individual word read and the frequency, 
  display a summary of all words and quanties read so far, and to clear the set of all data.
+ Files may also be read in parallel or from a stream, and optional modes, described at their
+ methods, count n-grams, count approximately in fixed memory, index where words occur, or
+ spill the word table to disk past a memory limit.
  
  The cleanup method is a helper method used to make it easy for the client to store words;
  it removes junk characters according to a set of rules for the program.
@@ -31,6 +37,18 @@
 #include <xstring.h> //fsu::String
 #include <list.h> //fsu::List
 #include <oaa.h>
+#include <art.h>
+#include <hashtable.h>
+#include <textsource.h> //fsu::TextSource, used by ReadText
+#include <topk.h> //fsu::TopK, used by WriteTopK
+#include <textbuffer.h> //fsu::TextBuffer, used by WriteFrequencyReport
+#include <blockreader.h> //fsu::BlockReader, used by ReadStream
+#include <serial.h> //fsu::ByteBuffer, used by ReadStream
+#include <ngram.h> //fsu::NGramCounter, used in n-gram mode
+#include <sketch.h> //fsu::CountMin, fsu::HyperLogLog, used in approximate mode
+#include <progress.h> //fsu::ReadProgress, used by ReadText and ReadStream
+#include <postings.h> //fsu::Postings, used in index mode
+#include <runs.h> //fsu::RunWriter, fsu::RunMerger, used with a memory limit
 
 class WordSmith
 {
@@ -38,13 +56,50 @@ class WordSmith
 public:
     WordSmith();            //default constructor
     ~WordSmith();           //destructor
+    // with Threads() > 1 a mapped file of a megabyte or more is counted in parallel chunks;
+    // showProgress reports about once a second (progress.h)
     bool ReadText       (const fsu::String& infile, bool showProgress = 0); //read file contents
+    // each file into its own table on Threads() workers, merged and reported in list order
+    size_t ReadTexts    (const fsu::List<fsu::String>& infiles, bool showProgress = 0); //returns number read
+    // reads on a second thread in 4 MB blocks (blockreader.h); the words are recorded under name
+    bool ReadStream     (int fd, const fsu::String& name, bool showProgress = 0); //read a descriptor (0 = stdin) to its end
     bool WriteReport    (const fsu::String& outfile, unsigned short kw = 15, unsigned short dw = 15,
                          std::ios_base::fmtflags kf = std::ios_base::left, //key justify
                          std::ios_base::fmtflags df = std::ios_base::right //data justify
                          ) const;
+    // ties in alphabetical order; rows are ordered by a counting sort on frequency
+    bool WriteFrequencyReport (const fsu::String& outfile, unsigned short kw = 15, unsigned short dw = 15,
+                               std::ios_base::fmtflags kf = std::ios_base::left, //key justify
+                               std::ios_base::fmtflags df = std::ios_base::right //data justify
+                               ) const; //most frequent first
+    // ties in report order; a size-k heap over the set, or none if TrackTopK covers k
+    bool WriteTopK      (size_t k, const fsu::String& outfile, unsigned short kw = 15, unsigned short dw = 15) const; //k most frequent words
+    bool WriteNGramReport (size_t k, const fsu::String& outfile, unsigned short kw = 30, unsigned short dw = 15) const; //k most frequent n-grams
+    // writes statefile.tmp and renames it into place; n-grams and the index are not saved
+    bool SaveState      (const fsu::String& statefile) const; //checkpoint words, counts and files
+    bool LoadState      (const fsu::String& statefile); //replaces the current data; false if unreadable
     void ShowSummary    () const;
-    void ClearData      ();
+    void ClearData      (); //also empties n-gram counts and the index and removes spilled runs; modes stay set
+    void SetThreads     (size_t n); //ReadText threads; 0 = one per hardware thread
+    size_t Threads      () const { return threads_; }
+    void TrackTopK      (size_t k); //keep the k most frequent words current while reading; 0 = off
+    size_t TrackedTopK  () const { return topk_.Capacity(); }
+    // counts are kept within megabytes by lossy counting (ngram.h); files are read on one thread
+    bool SetNGrams      (size_t n, size_t megabytes = 256); //count n-grams (n = 2 or 3) from now on; 0 = off
+    // Count-Min and HyperLogLog estimates (sketch.h) replace the word list, folding in the words
+    // read so far; 0 returns to exact mode with no data. Files are read on one thread
+    bool SetApproximate (size_t megabytes, size_t k = 100); //fixed-memory sketches and top k words; 0 = exact
+    bool Approximate    () const { return approx_.On(); }
+    size_t NGrams       () const { return grams_.Order(); }
+    // occurrences are (file number, word position) pairs (postings.h); files are read on one thread
+    void SetIndexing    (bool on); //record where words occur from now on; off discards the index
+    bool Indexing       () const { return indexing_; }
+    bool ShowOccurrences(fsu::String word) const; //files and positions of word; false if not indexing
+    bool ShowCommon     (fsu::String a, fsu::String b) const; //files holding both words; false if not indexing
+    // reports merge the sorted runs (runs.h) with the table; once spilled, there is no frequency
+    // report or SaveState, files are read on one thread, and 0 reads the runs back
+    bool SetMemoryLimit (size_t megabytes); //spill the word table to disk past this size; 0 = no limit
+    size_t MemoryLimit  () const { return spill_.Limit() >> 20; }
     
 private:
     
@@ -54,16 +109,149 @@ private:
     typedef fsu::String                                 KeyType;
     typedef size_t                                      DataType;
     
+    // choose one: LLRB tree, adaptive radix tree or hash table (same API, same report order)
     typedef fsu::OAA <KeyType,DataType>                 SetType;
+    // typedef fsu::ART <DataType>                         SetType;
+    // typedef fsu::HashTable <KeyType,DataType>           SetType;
     
     SetType                     frequency_; //specified set; holds frequency of keys
     ListType                    infiles_; //list of file names
     size_t                      count_; //keeps track of how many words were read
+    size_t                      threads_; //ReadText worker threads; 1 = serial
+    
+    typedef fsu::TopK <KeyType,DataType>                TopKType;
+    TopKType                    topk_; //most frequent words so far, when TrackedTopK() > 0
+    TopKType* Tracking () { return topk_.Capacity() > 0 ? &topk_ : nullptr; }
+    
+    fsu::NGramCounter           grams_; //n-gram counts, when NGrams() > 0
+    fsu::NGramCounter* Grams () { return grams_.Order() > 0 ? &grams_ : nullptr; }
+    
+    fsu::Postings               index_; //where words occur, when Indexing()
+    bool                        indexing_;
+    fsu::Postings* Index () { return indexing_ ? &index_ : nullptr; }
+    void StartIndex () { if (indexing_) index_.Start((uint32_t)infiles_.Size()); } //the next words begin the next file
+    
+    // approximate counts, when Approximate(): the words themselves are not kept
+    class ApproxCounts
+    {
+    public:
+        bool     Reset    (size_t budget); //sketches within budget bytes; 0 = off
+        void     Clear    () { if (On()) { counts_.Clear(); distinct_.Clear(); } }
+        bool     On       () const { return counts_.Depth() > 0; }
+        DataType Add      (const KeyType& key, DataType n = 1); //returns the key's estimated count
+        size_t   Distinct () const { return (size_t)(distinct_.Estimate() + 0.5); }
+        const fsu::CountMin&    Counts    () const { return counts_; }
+        const fsu::HyperLogLog& Distincts () const { return distinct_; }
+    private:
+        fsu::CountMin       counts_;
+        fsu::HyperLogLog    distinct_;
+        fsu::Hash<KeyType>  hash_;
+    };
+    ApproxCounts                approx_;
+    
+    // the word table under a memory limit: past it, the words go to disk as a sorted run
+    class SpillRuns
+    {
+    public:
+        SpillRuns () : limit_(0), held_(0), entryBytes_(0), files_(), vocab_(0), vocabKnown_(0) {}
+        ~SpillRuns () { Clear(); }
+        void   SetLimit (size_t bytes) { limit_ = bytes; }
+        size_t Limit    () const { return limit_; }
+        bool   On       () const { return limit_ > 0; }
+        void   Start    (size_t entryBytes) { entryBytes_ = entryBytes; vocabKnown_ = 0; } //counts are about to change
+        void   Hold     (size_t bytes) { held_ = bytes; } //the table's memory, as it is now
+        bool   Full     (size_t keyBytes) { held_ += entryBytes_ + keyBytes; return held_ > limit_; } //a new word
+        template < class C >
+        bool   Write    (C& frequency); //frequency to a new run, then empties it; false stops spilling
+        size_t MergeBuffer () const; //read buffer per run in a merge
+        bool   Write    (ApproxCounts&) { return 1; } //sketches are not spilled
+        size_t Runs     () const { return files_.Size(); }
+        const ListType& Files () const { return files_; }
+        void   Clear    (); //removes the runs
+        void   SetVocab (size_t n) const { vocab_ = n; vocabKnown_ = 1; } //found by a merge
+        bool   VocabKnown () const { return vocabKnown_; }
+        size_t Vocab    () const { return vocab_; }
+    private:
+        size_t   limit_, held_, entryBytes_;
+        ListType files_; //the runs, oldest first
+        mutable size_t vocab_;
+        mutable bool   vocabKnown_;
+        
+        bool Compact (); //merges the runs into one; false leaves them as they were
+        
+        SpillRuns (const SpillRuns&);
+        SpillRuns& operator = (const SpillRuns&);
+    };
+    SpillRuns                   spill_;
+    bool Spilled () const { return spill_.Runs() > 0; }
+    SpillRuns* Spill () { return spill_.On() && !approx_.On() ? &spill_ : nullptr; }
+    
+    typedef fsu::HashTable <KeyType,DataType>           LocalSetType; //per-thread counts in a parallel read
+    
+    static void   Cleanup (fsu::String&); //removes invalid characters from string
+    static size_t Cleanup (const char* s, size_t length, char* out); //cleaned s[0,length) to out; returns its length
+    
+    // keys for cleaned words: keys_[n] always has size n, so a word shorter than MaxKey is
+    // copied into it without allocating (long_ reallocates only when the length changes);
+    // the table copies a key only when the word is new
+    class KeyScratch
+    {
+    public:
+        const fsu::String& Make (const char* word, size_t n);
+    private:
+        static const size_t MaxKey = 64;
+        fsu::String keys_[MaxKey];
+        fsu::String long_;
+    };
+    
+    struct Chunk //one worker's share of a parallel read
+    {
+        const char * begin, * end;
+        LocalSetType frequency;
+        size_t       words;
+    };
+    static void CountChunk (Chunk* c); //worker thread body
+    
+    struct FileJob //one file of a multi-file read
+    {
+        fsu::String  name;
+        LocalSetType frequency;
+        size_t       words;
+        size_t       newWords; //vocabulary estimate it added, when counted into approx_
+        bool         opened, error, done;
+    };
+    struct FileQueue; //work list shared by the ReadTexts workers (wordsmith2.cpp)
+    static void CountFiles (FileQueue* q); //worker thread body
+    
+    template < class C >
+    static size_t CountWords (fsu::TextSource& source, C& frequency, fsu::ReadProgress* progress,
+                              TopKType* topk = nullptr, fsu::NGramCounter* grams = nullptr,
+                              fsu::Postings* index = nullptr, SpillRuns* spill = nullptr); //returns words counted; updates topk, grams and index if given
+    template < class C >
+    static DataType Tally (C& frequency, const KeyType& key) { return ++frequency[key]; } //counts key; returns its count
+    static DataType Tally (ApproxCounts& approx, const KeyType& key) { return approx.Add(key); }
+    size_t Count        (fsu::TextSource& source, fsu::ReadProgress* progress); //CountWords into approx_ or frequency_
+    void   StartProgress(fsu::ReadProgress& progress, size_t vocabSize) const; //the table as a read begins
+    size_t ReadParallel (const fsu::TextSource& source, size_t threads, bool showProgress);
+    void   EndRead      (const fsu::String& infile, size_t words, size_t initVocabSize); //reports a read; adds infile
+    void   WriteFileList(std::ostream& os) const; //names of the files read, comma separated
+    void   WriteBounds  (std::ostream& os) const; //error bounds of approximate counts
+    template < class F >
+    bool   MergeCounts  (F f) const; //f(key, count) for each word of the runs and the table, in report order
+    
+    class StateWriter; //front-codes the words of SaveState (wordsmith2.cpp)
+    class StateReader; //decodes them for LoadState
     
-    static void Cleanup (fsu::String&); //removes invalid characters from string
+    struct Row //one line of a frequency report; key points into the set
+    {
+        const KeyType * key;
+        DataType        count;
+    };
+    static bool SortByFrequency (Row*& rows, size_t n, DataType maxCount); //stable, most frequent first
     
     size_t WordsRead() const; //outputs word count (non-unique)
     size_t VocabSize() const; //outputs size of vocabulary (unique)
+    size_t VocabBefore() const { return Spilled() ? 0 : VocabSize(); } //at the start of a read: no merge
     
     // copy constructor and assignment operator - not implemented
     WordSmith (const WordSmith &);